@@ -6,6 +6,7 @@
 #include <iostream>
 
 #include "scope/testrunner.h"
+#include "scope/alloccount.h"
 
 int main(int argc, char *argv[]) {
   return scope::DefaultRun(std::cout, argc, argv) ? 0: 1;
@@ -0,0 +1,247 @@
+/*
+  © 2016, Jon Stewart
+  Released under the terms of the Boost license (http://www.boost.org/LICENSE_1_0.txt). See License.txt for details.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <sstream>
+#include <vector>
+
+/**************************** Allocation accounting *****************************
+
+  Including scope/alloccount.h in exactly one translation unit of a test
+  binary replaces the global operator new and delete with versions that count
+  what each thread allocates and frees. The counts are plain thread_local
+  integers: no locks, no atomics, and nothing for threads to contend on, so
+  turning accounting on does not perturb the timings of the code under test.
+
+  With accounting installed, the runner can report allocations per test
+  (--alloc-report), and tests can assert on them:
+
+    SCOPE_ASSERT_NO_ALLOC(sum = std::accumulate(v.begin(), v.end(), 0));
+    SCOPE_ASSERT_MAX_ALLOCATIONS(1, v.reserve(100));
+
+  Only allocations made on the calling thread are counted, and over-aligned
+  (std::align_val_t) allocations are not counted at all. Without
+  alloccount.h, these assertions fail rather than pass vacuously.
+
+  Leak tracking (--leaks) builds on the same hooks. While a test runs, each
+  block it allocates is tagged with a serial number unique to that run, and
+  only frees of blocks carrying the tag are subtracted again. Whatever is
+  still live when the test returns is suspected to have leaked. The sizes of
+  the first LeakTracker::MaxBlocks live blocks are kept in a fixed table, so
+  the report can say what leaked without tracking needing the heap itself.
+  A block freed on another thread, e.g. the state of a std::thread, which
+  the new thread deletes, is noted in a small lock-free ring, and the scope
+  collects the notes when it finishes. So it only counts as leaked if it is
+  still live then, or if so many other threads free tracked blocks
+  meanwhile that the ring wraps. Objects deliberately kept alive, e.g.
+  function-local statics initialized by the test, show up as leaks too.
+*/
+
+namespace scope {
+  struct AllocationCounts {
+    uint64_t Allocations,
+             Deallocations,
+             BytesAllocated,
+             BytesFreed;
+  };
+
+  // zero-initialized POD, so safe to touch from inside operator new
+  inline AllocationCounts& threadAllocations() {
+    static thread_local AllocationCounts counts;
+    return counts;
+  }
+
+  struct LeakTracker {
+    enum { MaxBlocks = 32 };
+
+    struct Block {
+      void*       Ptr;
+      std::size_t Size;
+    };
+
+    uint64_t Serial,       // nonzero while tracking
+             LiveCount,
+             LiveBytes;
+    Block    Blocks[MaxBlocks];
+
+    LeakTracker* Enclosing; // suspended by a nested LeakScope
+  };
+
+  inline LeakTracker& threadLeakTracker() {
+    static thread_local LeakTracker tracker;
+    return tracker;
+  }
+
+  inline void trackAllocation(LeakTracker& tracker, void* p, std::size_t size) {
+    ++tracker.LiveCount;
+    tracker.LiveBytes += size;
+    for (LeakTracker::Block& b: tracker.Blocks) {
+      if (!b.Ptr) {
+        b.Ptr = p;
+        b.Size = size;
+        break;
+      }
+    }
+  }
+
+  inline void trackFree(LeakTracker& tracker, void* p, std::size_t size) {
+    --tracker.LiveCount;
+    tracker.LiveBytes -= size;
+    for (LeakTracker::Block& b: tracker.Blocks) {
+      if (b.Ptr == p) {
+        b.Ptr = nullptr;
+        break;
+      }
+    }
+  }
+
+  // tracked blocks freed on threads other than the one tracking them
+  struct ForeignFrees {
+    enum { MaxNotes = 256 };
+
+    struct Note {
+      std::atomic<uint64_t>    Serial; // of the scope which allocated the block; 0 for none
+      std::atomic<void*>       Ptr;
+      std::atomic<std::size_t> Size;
+    };
+
+    std::atomic<uint64_t> Next;
+    Note                  Notes[MaxNotes];
+  };
+
+  // zero-initialized, so safe to touch from inside operator delete
+  inline ForeignFrees& foreignFrees() {
+    static ForeignFrees frees;
+    return frees;
+  }
+
+  inline void noteForeignFree(uint64_t serial, void* p, std::size_t size) {
+    ForeignFrees& frees(foreignFrees());
+    ForeignFrees::Note& note(frees.Notes[frees.Next++ % ForeignFrees::MaxNotes]);
+    note.Serial.store(0, std::memory_order_relaxed);
+    note.Ptr.store(p, std::memory_order_relaxed);
+    note.Size.store(size, std::memory_order_relaxed);
+    note.Serial.store(serial, std::memory_order_release);
+  }
+
+  // takes the frees noted for the tracker's scope off its balance
+  inline void collectForeignFrees(LeakTracker& tracker) {
+    for (ForeignFrees::Note& note: foreignFrees().Notes) {
+      uint64_t serial = tracker.Serial;
+      if (note.Serial.load(std::memory_order_acquire) == serial) {
+        void* p = note.Ptr.load(std::memory_order_relaxed);
+        const std::size_t size = note.Size.load(std::memory_order_relaxed);
+        if (note.Serial.compare_exchange_strong(serial, 0)) {
+          trackFree(tracker, p, size);
+        }
+      }
+    }
+  }
+
+  struct LeakReport {
+    LeakReport(): Count(0), Bytes(0) {}
+
+    uint64_t Count,
+             Bytes;
+    std::vector<std::size_t> Sizes; // of at most LeakTracker::MaxBlocks blocks
+  };
+
+  // Tracks the calling thread from construction until finish(). Scopes nest:
+  // the enclosing one is suspended meanwhile, and resumed by finish().
+  class LeakScope {
+  public:
+    LeakScope(): Outer(threadLeakTracker()), Finished(false) {
+      static std::atomic<uint64_t> serials(0);
+      LeakTracker& tracker(threadLeakTracker());
+      tracker = LeakTracker();
+      tracker.Serial = ++serials;
+      tracker.Enclosing = &Outer;
+    }
+
+    ~LeakScope() {
+      if (!Finished) {
+        threadLeakTracker() = Outer;
+      }
+    }
+
+    LeakScope(const LeakScope&) = delete;
+    LeakScope& operator=(const LeakScope&) = delete;
+
+    LeakReport finish() {
+      LeakTracker& tracker(threadLeakTracker());
+      collectForeignFrees(tracker);
+      const LeakTracker done(tracker);
+      tracker = Outer; // stop tagging for this scope before the report allocates
+      Finished = true;
+      LeakReport report;
+      report.Count = done.LiveCount;
+      report.Bytes = done.LiveBytes;
+      for (const LeakTracker::Block& b: done.Blocks) {
+        if (b.Ptr) {
+          report.Sizes.push_back(b.Size);
+        }
+      }
+      return report;
+    }
+
+  private:
+    LeakTracker Outer;
+    bool        Finished;
+  };
+
+  inline bool& allocationCountingInstalled() {
+    static bool installed = false;
+    return installed;
+  }
+
+  inline AllocationCounts operator-(const AllocationCounts& after, const AllocationCounts& before) {
+    AllocationCounts delta;
+    delta.Allocations = after.Allocations - before.Allocations;
+    delta.Deallocations = after.Deallocations - before.Deallocations;
+    delta.BytesAllocated = after.BytesAllocated - before.BytesAllocated;
+    delta.BytesFreed = after.BytesFreed - before.BytesFreed;
+    return delta;
+  }
+
+  class AllocationScope {
+  public:
+    AllocationScope(): Before(threadAllocations()) {}
+
+    AllocationCounts counts() const {
+      return threadAllocations() - Before;
+    }
+
+    template<typename ExceptionType>
+    void checkMax(uint64_t max, const char* const file, int line, const char* const statement) const {
+      if (!allocationCountingInstalled()) {
+        throw ExceptionType(file, line, "allocation counting is not installed; include scope/alloccount.h in one source file");
+      }
+      const AllocationCounts delta(counts());
+      if (delta.Allocations > max) {
+        std::ostringstream buf;
+        buf << statement << " made " << delta.Allocations << " allocations (" << delta.BytesAllocated
+            << " bytes), at most " << max << " allowed";
+        throw ExceptionType(file, line, buf.str().c_str());
+      }
+    }
+
+  private:
+    AllocationCounts Before;
+  };
+}
+
+#define SCOPE_ASSERT_MAX_ALLOCATIONS(maxAllocs, statement) \
+  do { \
+    scope::AllocationScope scopeAllocations; \
+    statement; \
+    scopeAllocations.checkMax<scope::TestFailure>((maxAllocs), __FILE__, __LINE__, #statement); \
+  } while (false)
+
+#define SCOPE_ASSERT_NO_ALLOC(statement) \
+  SCOPE_ASSERT_MAX_ALLOCATIONS(0, statement)
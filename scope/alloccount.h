@@ -0,0 +1,136 @@
+/*
+  © 2016, Jon Stewart
+  Released under the terms of the Boost license (http://www.boost.org/LICENSE_1_0.txt). See License.txt for details.
+*/
+
+#pragma once
+
+// Include this in exactly one source file of a test binary, e.g. next to
+// testrunner.h in main.cpp. It replaces the global operator new and delete.
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+#include "allocations.h"
+
+namespace scope {
+  namespace {
+    // every block is prefixed with its requested size, so frees can be
+    // counted in bytes, and with the serial of the leak-tracked test run
+    // that allocated it, if any; the prefix keeps the block maximally aligned
+    const std::size_t AllocPrefix = alignof(std::max_align_t) < 2 * sizeof(std::size_t)
+                                    ? 2 * sizeof(std::size_t): alignof(std::max_align_t);
+
+    void* countedAlloc(std::size_t size) {
+      void* base = std::malloc(size + AllocPrefix);
+      if (!base) {
+        return nullptr;
+      }
+      std::size_t* prefix = static_cast<std::size_t*>(base);
+      void* p = static_cast<char*>(base) + AllocPrefix;
+      prefix[0] = size;
+      AllocationCounts& counts(threadAllocations());
+      ++counts.Allocations;
+      counts.BytesAllocated += size;
+      LeakTracker& tracker(threadLeakTracker());
+      prefix[1] = static_cast<std::size_t>(tracker.Serial);
+      if (tracker.Serial) {
+        trackAllocation(tracker, p, size);
+      }
+      return p;
+    }
+
+    void* countedNew(std::size_t size) {
+      while (true) {
+        void* p = countedAlloc(size);
+        if (p) {
+          return p;
+        }
+        std::new_handler handler = std::get_new_handler();
+        if (!handler) {
+          throw std::bad_alloc();
+        }
+        handler();
+      }
+    }
+
+    void countedFree(void* p) {
+      if (!p) {
+        return;
+      }
+      char* base = static_cast<char*>(p) - AllocPrefix;
+      const std::size_t* prefix = reinterpret_cast<std::size_t*>(base);
+      AllocationCounts& counts(threadAllocations());
+      ++counts.Deallocations;
+      counts.BytesFreed += prefix[0];
+      // the block may belong to a suspended, enclosing scope, or to one on another thread
+      const uint64_t serial = prefix[1];
+      LeakTracker* t = &threadLeakTracker();
+      while (t && !(t->Serial && serial == t->Serial)) {
+        t = t->Enclosing;
+      }
+      if (t) {
+        trackFree(*t, p, prefix[0]);
+      }
+      else if (serial) {
+        noteForeignFree(serial, p, prefix[0]);
+      }
+      std::free(base);
+    }
+
+    const bool CountingInstalled = (allocationCountingInstalled() = true);
+  }
+}
+
+void* operator new(std::size_t size) {
+  return scope::countedNew(size);
+}
+
+void* operator new[](std::size_t size) {
+  return scope::countedNew(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+  try {
+    return scope::countedNew(size);
+  }
+  catch (...) {
+    return nullptr;
+  }
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+  try {
+    return scope::countedNew(size);
+  }
+  catch (...) {
+    return nullptr;
+  }
+}
+
+void operator delete(void* p) noexcept {
+  scope::countedFree(p);
+}
+
+void operator delete[](void* p) noexcept {
+  scope::countedFree(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept {
+  scope::countedFree(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept {
+  scope::countedFree(p);
+}
+
+#if defined(__cpp_sized_deallocation)
+void operator delete(void* p, std::size_t) noexcept {
+  scope::countedFree(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept {
+  scope::countedFree(p);
+}
+#endif
@@ -0,0 +1,229 @@
+/*
+  © 2016, Jon Stewart
+  Released under the terms of the Boost license (http://www.boost.org/LICENSE_1_0.txt). See License.txt for details.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+#if __cplusplus >= 201703L && defined(__has_include)
+  #if __has_include(<memory_resource>)
+    #include <memory_resource>
+    #define SCOPE_HAVE_PMR 1
+  #endif
+#endif
+
+/**************************** Test arena *****************************
+
+  Each runner thread has a monotonic arena, rewound after every test. The
+  runner keeps its own per-test bookkeeping there, and so can fixtures:
+
+    namespace scope { template<> struct ArenaFixture<MyFixture>: std::true_type {}; }
+
+  places each MyFixture of a SCOPE_FIXTURE (not SCOPE_FIXTURE_CTOR) in it,
+  default-constructed, rather than on the heap. So neither shows up in the
+  allocation counts and leak checks of the test, nor interleaves with the
+  blocks of the code under test.
+
+  The arena gets its memory from malloc(), not operator new, in chunks
+  which are kept for reuse once the arena has grown. Tests may use it too,
+  for memory that only has to last until the test returns:
+
+    std::vector<int, scope::ArenaAllocator<int>> v(scope::testAllocator<int>());
+
+  or, when compiled as C++17, through scope::testMemoryResource(), a
+  std::pmr::memory_resource. Freeing arena memory does nothing.
+*/
+
+namespace scope {
+  class Arena {
+  public:
+    enum {
+      FirstChunk = 64 * 1024,
+      MaxChunks  = 32 // each twice the size of the one before
+    };
+
+    // a position to rewind to
+    struct Mark {
+      unsigned int Chunk;
+      std::size_t  Used;
+    };
+
+    Arena(): NumChunks(0), Current(0) {}
+
+    ~Arena() {
+      for (unsigned int i = 0; i < NumChunks; ++i) {
+        std::free(Chunks[i].Data);
+      }
+    }
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    void* allocate(std::size_t size, std::size_t align) {
+      if (!NumChunks) {
+        grow(size + align);
+      }
+      for (;;) {
+        Chunk& c(Chunks[Current]);
+        const uintptr_t begin = reinterpret_cast<uintptr_t>(c.Data),
+                        p = (begin + c.Used + align - 1) & ~uintptr_t(align - 1);
+        if (p + size <= begin + c.Size) {
+          c.Used = p + size - begin;
+          return reinterpret_cast<void*>(p);
+        }
+        if (Current + 1 < NumChunks) {
+          Chunks[++Current].Used = 0;
+        }
+        else {
+          grow(size + align);
+        }
+      }
+    }
+
+    template<class T> T* create() {
+      return new (allocate(sizeof(T), alignof(T))) T;
+    }
+
+    bool owns(const void* p) const {
+      const uintptr_t addr = reinterpret_cast<uintptr_t>(p);
+      for (unsigned int i = 0; i < NumChunks; ++i) {
+        const uintptr_t begin = reinterpret_cast<uintptr_t>(Chunks[i].Data);
+        if (begin <= addr && addr < begin + Chunks[i].Size) {
+          return true;
+        }
+      }
+      return false;
+    }
+
+    Mark mark() const {
+      return Mark{Current, NumChunks ? Chunks[Current].Used: 0};
+    }
+
+    void rewind(const Mark& m) {
+      Current = m.Chunk;
+      if (NumChunks) {
+        Chunks[Current].Used = m.Used;
+      }
+    }
+
+  private:
+    struct Chunk {
+      char*       Data;
+      std::size_t Size,
+                  Used;
+    };
+
+    void grow(std::size_t atLeast) {
+      if (NumChunks == MaxChunks) {
+        throw std::bad_alloc();
+      }
+      std::size_t size = std::size_t(FirstChunk) << NumChunks;
+      while (size < atLeast) {
+        size *= 2;
+      }
+      char* data = static_cast<char*>(std::malloc(size));
+      if (!data) {
+        throw std::bad_alloc();
+      }
+      Chunks[NumChunks] = Chunk{data, size, 0};
+      Current = NumChunks++;
+    }
+
+    Chunk        Chunks[MaxChunks];
+    unsigned int NumChunks,
+                 Current;
+  };
+
+  inline Arena& threadArena() {
+    static thread_local Arena arena;
+    return arena;
+  }
+
+  // everything allocated from the arena while this is in scope is released when it ends
+  class ArenaScope {
+  public:
+    explicit ArenaScope(Arena& arena): TheArena(arena), Start(arena.mark()) {}
+
+    ~ArenaScope() {
+      TheArena.rewind(Start);
+    }
+
+    ArenaScope(const ArenaScope&) = delete;
+    ArenaScope& operator=(const ArenaScope&) = delete;
+
+  private:
+    Arena&      TheArena;
+    Arena::Mark Start;
+  };
+
+  // a deleter, for unique_ptrs to objects made with Arena::create()
+  template<class T> struct ArenaDestroy {
+    void operator()(T* p) const {
+      p->~T();
+    }
+  };
+
+  template<class T> class ArenaAllocator {
+  public:
+    typedef T value_type;
+
+    explicit ArenaAllocator(Arena& arena): TheArena(&arena) {}
+
+    template<class U> ArenaAllocator(const ArenaAllocator<U>& other): TheArena(other.arena()) {}
+
+    T* allocate(std::size_t n) {
+      return static_cast<T*>(TheArena->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T*, std::size_t) {}
+
+    Arena* arena() const {
+      return TheArena;
+    }
+
+  private:
+    Arena* TheArena;
+  };
+
+  template<class T, class U> bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) {
+    return a.arena() == b.arena();
+  }
+
+  template<class T, class U> bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) {
+    return a.arena() != b.arena();
+  }
+
+  template<class T> ArenaAllocator<T> testAllocator() {
+    return ArenaAllocator<T>(threadArena());
+  }
+
+#ifdef SCOPE_HAVE_PMR
+  class ArenaResource: public std::pmr::memory_resource {
+  public:
+    explicit ArenaResource(Arena& arena): TheArena(arena) {}
+
+  private:
+    virtual void* do_allocate(std::size_t bytes, std::size_t align) {
+      return TheArena.allocate(bytes, align);
+    }
+
+    virtual void do_deallocate(void*, std::size_t, std::size_t) {}
+
+    virtual bool do_is_equal(const std::pmr::memory_resource& other) const noexcept {
+      return this == &other;
+    }
+
+    Arena& TheArena;
+  };
+
+  inline std::pmr::memory_resource* testMemoryResource() {
+    static thread_local ArenaResource resource(threadArena());
+    return &resource;
+  }
+#endif
+}
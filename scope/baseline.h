@@ -0,0 +1,343 @@
+/*
+  © 2016, Jon Stewart
+  Released under the terms of the Boost license (http://www.boost.org/LICENSE_1_0.txt). See License.txt for details.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <istream>
+#include <iterator>
+#include <limits>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "benchmark.h"
+#include "stats.h"
+
+/**************************** Benchmark baselines *****************************
+
+  A baseline is the raw samples of a benchmark run, saved as JSON:
+
+    {"benchmarks": [
+      {"name": "vectorPushBack", "source": "test4.cpp", "iterations": 660977,
+       "samples": [19.30, 19.41, ...]},
+      ...
+    ]}
+
+  compareBaseline() matches benchmarks by name and source file. A benchmark
+  has regressed when its median is more than the allowed fraction slower than
+  the baseline's median _and_ a one-sided Mann-Whitney U test says the new
+  samples are slower with p below the significance level. Requiring both
+  keeps noise from failing a run on a large but insignificant delta, and
+  keeps a tiny but consistent slowdown from failing it either.
+
+  readBaseline() is only meant to read what writeBaseline() writes. Unknown
+  keys are skipped, but it is not a general JSON parser.
+*/
+
+namespace scope {
+  struct BaselineComparison {
+    BaselineComparison():
+      BaseMedian(0.0), CurMedian(0.0), Delta(0.0), PValue(1.0), Missing(false), Regressed(false), Improved(false) {}
+
+    std::string Name;
+    double      BaseMedian,
+                CurMedian,
+                Delta,      // (cur - base) / base
+                PValue;
+    bool        Missing,    // not in the baseline
+                Regressed,
+                Improved;
+  };
+
+  inline void writeJsonString(std::ostream& out, const std::string& str) {
+    out << '"';
+    for (char c: str) {
+      switch (c) {
+        case '"':  out << "\\\""; break;
+        case '\\': out << "\\\\"; break;
+        case '\n': out << "\\n"; break;
+        case '\t': out << "\\t"; break;
+        case '\r': out << "\\r"; break;
+        default:
+          if (static_cast<unsigned char>(c) < 0x20) {
+            out << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(c)
+                << std::dec << std::setfill(' ');
+          }
+          else {
+            out << c;
+          }
+      }
+    }
+    out << '"';
+  }
+
+  inline void writeBaseline(std::ostream& out, const std::vector<BenchmarkResult>& results) {
+    out << std::setprecision(std::numeric_limits<double>::max_digits10);
+    out << "{\"benchmarks\": [";
+    bool first = true;
+    for (const BenchmarkResult& r: results) {
+      out << (first ? "\n  ": ",\n  ") << "{\"name\": ";
+      writeJsonString(out, r.Name);
+      out << ", \"source\": ";
+      writeJsonString(out, r.SourceFile);
+      out << ", \"iterations\": " << r.Iterations << ", \"samples\": [";
+      for (std::size_t i = 0; i < r.SampleNs.size(); ++i) {
+        out << (i ? ", ": "") << r.SampleNs[i];
+      }
+      out << "]}";
+      first = false;
+    }
+    out << "\n]}\n";
+  }
+
+  class BaselineReader {
+  public:
+    BaselineReader(std::istream& in):
+      Text(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()), Pos(0) {}
+
+    bool read(std::vector<BenchmarkResult>& results, std::string& error) {
+      try {
+        expect('{');
+        if (!peekIs('}')) {
+          do {
+            const std::string key(readString());
+            expect(':');
+            if (key == "benchmarks") {
+              readBenchmarks(results);
+            }
+            else {
+              skipValue();
+            }
+          } while (consume(','));
+        }
+        expect('}');
+        return true;
+      }
+      catch (const std::runtime_error& e) {
+        std::ostringstream buf;
+        buf << e.what() << " at offset " << Pos;
+        error = buf.str();
+        return false;
+      }
+    }
+
+  private:
+    void readBenchmarks(std::vector<BenchmarkResult>& results) {
+      expect('[');
+      if (consume(']')) {
+        return;
+      }
+      do {
+        BenchmarkResult r;
+        expect('{');
+        if (!peekIs('}')) {
+          do {
+            const std::string key(readString());
+            expect(':');
+            if (key == "name") {
+              r.Name = readString();
+            }
+            else if (key == "source") {
+              r.SourceFile = readString();
+            }
+            else if (key == "iterations") {
+              r.Iterations = static_cast<uint64_t>(readNumber());
+            }
+            else if (key == "samples") {
+              expect('[');
+              if (!consume(']')) {
+                do {
+                  r.SampleNs.push_back(readNumber());
+                } while (consume(','));
+                expect(']');
+              }
+            }
+            else {
+              skipValue();
+            }
+          } while (consume(','));
+        }
+        expect('}');
+        r.Samples = static_cast<unsigned int>(r.SampleNs.size());
+        results.push_back(std::move(r));
+      } while (consume(','));
+      expect(']');
+    }
+
+    void skipSpace() {
+      while (Pos < Text.size() && std::isspace(static_cast<unsigned char>(Text[Pos]))) {
+        ++Pos;
+      }
+    }
+
+    bool peekIs(char c) {
+      skipSpace();
+      return Pos < Text.size() && Text[Pos] == c;
+    }
+
+    bool consume(char c) {
+      if (peekIs(c)) {
+        ++Pos;
+        return true;
+      }
+      return false;
+    }
+
+    void expect(char c) {
+      if (!consume(c)) {
+        throw std::runtime_error(std::string("expected '") + c + "'");
+      }
+    }
+
+    std::string readString() {
+      expect('"');
+      std::string str;
+      while (Pos < Text.size() && Text[Pos] != '"') {
+        char c = Text[Pos++];
+        if (c == '\\' && Pos < Text.size()) {
+          c = Text[Pos++];
+          switch (c) {
+            case 'n': c = '\n'; break;
+            case 't': c = '\t'; break;
+            case 'r': c = '\r'; break;
+            case 'u':
+              c = static_cast<char>(std::strtol(Text.substr(Pos, 4).c_str(), nullptr, 16));
+              Pos += 4;
+              break;
+          }
+        }
+        str += c;
+      }
+      expect('"');
+      return str;
+    }
+
+    double readNumber() {
+      skipSpace();
+      const char* begin = Text.c_str() + Pos;
+      char* end;
+      const double val = std::strtod(begin, &end);
+      if (end == begin) {
+        throw std::runtime_error("expected a number");
+      }
+      Pos += end - begin;
+      return val;
+    }
+
+    void skipValue() {
+      skipSpace();
+      if (peekIs('"')) {
+        readString();
+      }
+      else if (consume('[')) {
+        if (!consume(']')) {
+          do {
+            skipValue();
+          } while (consume(','));
+          expect(']');
+        }
+      }
+      else if (consume('{')) {
+        if (!consume('}')) {
+          do {
+            readString();
+            expect(':');
+            skipValue();
+          } while (consume(','));
+          expect('}');
+        }
+      }
+      else {
+        while (Pos < Text.size() && !std::strchr(",]} \t\r\n", Text[Pos])) {
+          ++Pos;
+        }
+      }
+    }
+
+    std::string Text;
+    std::size_t Pos;
+  };
+
+  inline bool readBaseline(std::istream& in, std::vector<BenchmarkResult>& results, std::string& error) {
+    return BaselineReader(in).read(results, error);
+  }
+
+  inline double sampleMedian(std::vector<double> samples) {
+    if (samples.empty()) {
+      return 0.0;
+    }
+    std::sort(samples.begin(), samples.end());
+    return percentile(samples.data(), samples.size(), 0.5);
+  }
+
+  inline std::vector<BaselineComparison> compareBaseline(const std::vector<BenchmarkResult>& baseline,
+                                                         const std::vector<BenchmarkResult>& current,
+                                                         double maxRegression,
+                                                         double significance)
+  {
+    std::vector<BaselineComparison> comps;
+    for (const BenchmarkResult& cur: current) {
+      BaselineComparison c;
+      c.Name = cur.Name;
+      c.CurMedian = sampleMedian(cur.SampleNs);
+
+      auto base = std::find_if(baseline.begin(), baseline.end(), [&cur](const BenchmarkResult& b) {
+        return b.Name == cur.Name && b.SourceFile == cur.SourceFile;
+      });
+      if (base == baseline.end() || base->SampleNs.empty()) {
+        c.Missing = true;
+      }
+      else {
+        c.BaseMedian = sampleMedian(base->SampleNs);
+        c.Delta = c.BaseMedian > 0.0 ? (c.CurMedian - c.BaseMedian) / c.BaseMedian: 0.0;
+        c.PValue = mannWhitneyGreater(base->SampleNs, cur.SampleNs);
+        c.Regressed = c.Delta > maxRegression && c.PValue < significance;
+        c.Improved = c.Delta < 0.0 && mannWhitneyGreater(cur.SampleNs, base->SampleNs) < significance;
+      }
+      comps.push_back(c);
+    }
+    return comps;
+  }
+
+  inline void writeComparison(std::ostream& out, const std::vector<BaselineComparison>& comps) {
+    std::size_t width = 9;
+    for (const BaselineComparison& c: comps) {
+      width = std::max(width, c.Name.size());
+    }
+    out << std::left << std::setw(width) << "Benchmark" << std::right
+        << std::setw(14) << "base median"
+        << std::setw(14) << "median"
+        << std::setw(10) << "delta"
+        << std::setw(10) << "p"
+        << "  result\n";
+    for (const BaselineComparison& c: comps) {
+      out << std::left << std::setw(width) << c.Name << std::right << std::fixed << std::setprecision(2);
+      if (c.Missing) {
+        out << std::setw(14) << "-"
+            << std::setw(14) << c.CurMedian
+            << std::setw(10) << "-"
+            << std::setw(10) << "-"
+            << "  new\n";
+        continue;
+      }
+      std::ostringstream delta;
+      delta << std::fixed << std::setprecision(1) << std::showpos << c.Delta * 100 << '%';
+      out << std::setw(14) << c.BaseMedian
+          << std::setw(14) << c.CurMedian
+          << std::setw(10) << delta.str()
+          << std::setw(10) << std::setprecision(4) << c.PValue
+          << "  " << (c.Regressed ? "REGRESSED": (c.Improved ? "faster": "ok")) << '\n';
+    }
+    out.unsetf(std::ios::floatfield);
+    out << std::setprecision(6);
+  }
+}
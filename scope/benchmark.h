@@ -0,0 +1,218 @@
+/*
+  © 2016, Jon Stewart
+  Released under the terms of the Boost license (http://www.boost.org/LICENSE_1_0.txt). See License.txt for details.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "test.h"
+#include "stats.h"
+
+/**************************** Benchmarks *****************************
+
+  A benchmark is a free function taking a BenchmarkState&, registered with
+  SCOPE_BENCHMARK() alongside ordinary tests. The body loops on
+  state.keepRunning(), and only the time spent inside that loop is measured:
+
+    SCOPE_BENCHMARK(vectorPushBack) {
+      std::vector<int> v;
+      while (state.keepRunning()) {
+        v.push_back(1);
+      }
+    }
+
+  The benchmark is first called with growing iteration counts until a single
+  call takes at least BenchmarkOptions::MinSampleTime. That count is then
+  used for every one of the BenchmarkOptions::Samples timed calls, and the
+  per-op time of each sample is kept and summarized by analyzeSamples(). The
+  buffer for both is allocated before timing begins. Benchmarks
+  are not run as tests; the runner runs them, serially and in-process, with
+  --bench.
+*/
+
+namespace scope {
+  typedef std::chrono::steady_clock BenchmarkClock;
+
+  // keeps the optimizer from discarding a value computed in a benchmark loop
+  template<typename T>
+  void doNotOptimize(const T& val) {
+#if defined(__GNUC__)
+    asm volatile("" : : "r,m"(val) : "memory");
+#else
+    static volatile const void* sink;
+    sink = &val;
+#endif
+  }
+
+  class BenchmarkState {
+  public:
+    explicit BenchmarkState(uint64_t iterations):
+      Iterations(iterations), Remaining(iterations), Started(false) {}
+
+    bool keepRunning() {
+      if (!Started) {
+        Started = true;
+        Start = BenchmarkClock::now();
+      }
+      if (Remaining) {
+        --Remaining;
+        return true;
+      }
+      Stop = BenchmarkClock::now();
+      return false;
+    }
+
+    uint64_t iterations() const {
+      return Iterations;
+    }
+
+    // nanoseconds spent in the keepRunning() loop
+    double elapsedNs() const {
+      if (!Started) {
+        return 0.0;
+      }
+      return std::chrono::duration<double, std::nano>(Stop - Start).count();
+    }
+
+  private:
+    uint64_t Iterations,
+             Remaining;
+    bool     Started;
+    BenchmarkClock::time_point Start,
+                               Stop;
+  };
+
+  typedef void (*BenchmarkFunction)(BenchmarkState&);
+
+  struct BenchmarkOptions {
+    BenchmarkOptions():
+      MinSampleTime(std::chrono::milliseconds(10)), Samples(30), MaxIterations(1000000000) {}
+
+    BenchmarkClock::duration MinSampleTime;
+    unsigned int             Samples;
+    uint64_t                 MaxIterations;
+    StatsOptions             Stats;
+  };
+
+  struct BenchmarkResult {
+    BenchmarkResult(): Iterations(0), TotalIterations(0), Samples(0), NsPerOp(0.0) {}
+
+    std::string Name,
+                SourceFile;
+    uint64_t     Iterations,  // per sample
+                 TotalIterations; // including calibration
+    unsigned int Samples;
+    double       NsPerOp;     // mean
+
+    std::vector<double> SampleNs; // ns/op of each sample, sorted
+    SampleStats         Stats;
+  };
+
+  // the summary of a benchmark, for reporters
+  inline MetricList benchmarkMetrics(const BenchmarkResult& r) {
+    MetricList m;
+    m.emplace_back("mean-ns", r.NsPerOp);
+    m.emplace_back("ci-low-ns", r.Stats.CiLow);
+    m.emplace_back("ci-high-ns", r.Stats.CiHigh);
+    m.emplace_back("median-ns", r.Stats.Median);
+    m.emplace_back("mad-ns", r.Stats.Mad);
+    m.emplace_back("min-ns", r.Stats.Min);
+    m.emplace_back("p90-ns", r.Stats.P90);
+    m.emplace_back("p99-ns", r.Stats.P99);
+    m.emplace_back("iterations", static_cast<double>(r.Iterations));
+    m.emplace_back("samples", static_cast<double>(r.Samples));
+    return m;
+  }
+
+  class BenchmarkCase: public AutoRegister {
+  public:
+    BenchmarkFunction Fn;
+
+    BenchmarkCase(const char* name, const char* source, BenchmarkFunction fn, int line = 0):
+      AutoRegister(name, source, 0.0, line, internTags("bench")), Fn(fn) {}
+
+    virtual bool isBenchmark() const { return true; }
+
+    // Calibrates the iteration count and takes the samples. Returns false,
+    // with the failure reported to sink, if the benchmark body fails.
+    bool measure(const BenchmarkOptions& opts, BenchmarkResult& result, ResultSink& sink) const {
+      result.Name = Name;
+      result.SourceFile = SourceFile;
+
+      std::vector<double> buf(bufferSize(opts.Samples, opts.Stats));
+
+      const double minNs = std::chrono::duration<double, std::nano>(opts.MinSampleTime).count();
+      double ns = 0.0;
+      uint64_t n = 1;
+      while (true) {
+        if (!sample(n, ns, sink)) {
+          return false;
+        }
+        result.TotalIterations += n;
+        if (ns >= minNs || n >= opts.MaxIterations) {
+          break;
+        }
+        // aim a little past the target, but never grow by more than 10x
+        const double guess = ns > 0.0 ? n * 1.2 * minNs / ns: n * 10.0;
+        n = std::min<uint64_t>(opts.MaxIterations, std::max<uint64_t>(n + 1, std::min(guess, n * 10.0)));
+      }
+
+      for (unsigned int i = 0; i < opts.Samples; ++i) {
+        if (!sample(n, ns, sink)) {
+          return false;
+        }
+        buf[i] = ns / n;
+        result.TotalIterations += n;
+      }
+      result.Iterations = n;
+      result.Samples = opts.Samples;
+      result.Stats = analyzeSamples(buf.data(), opts.Samples, opts.Stats);
+      result.NsPerOp = result.Stats.Mean;
+      buf.resize(opts.Samples);
+      result.SampleNs.swap(buf);
+      return true;
+    }
+
+  private:
+    bool sample(uint64_t iterations, double& ns, ResultSink& sink) const {
+      TestResult result;
+      BenchmarkState state(iterations);
+      runFunction([this, &state]() { (*Fn)(state); }, *this, false, result);
+      ns = state.elapsedNs();
+      for (const Failure& f: result.Failures) {
+        sink.testFailed(*this, f);
+      }
+      return result.passed();
+    }
+
+    // run as a plain test, a benchmark makes a single pass through its loop
+    virtual void _Run(ResultSink& sink) const {
+      double ns;
+      sample(1, ns, sink);
+    }
+  };
+
+  class Benchmark: public BenchmarkCase {
+  public:
+    Benchmark(const char* name, const char* source, BenchmarkFunction fn, int line = 0):
+      BenchmarkCase(name, source, fn, line)
+    {
+      TestRunner::root().insert(*this);
+    }
+
+    virtual ~Benchmark() {}
+  };
+}
+
+#define SCOPE_BENCHMARK(benchname) \
+  void benchname(scope::BenchmarkState& state); \
+  namespace scope { namespace user_defined { namespace { namespace SCOPE_CAT(benchname, ns) { \
+    Benchmark reg(#benchname, __FILE__, benchname, __LINE__); \
+  } } } } \
+  void benchname(scope::BenchmarkState& state)
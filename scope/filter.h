@@ -0,0 +1,143 @@
+/*
+  © 2016, Jon Stewart
+  Released under the terms of the Boost license (http://www.boost.org/LICENSE_1_0.txt). See License.txt for details.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**************************** Filters *****************************
+
+  -f/--filter and -s/--source-filter select tests by name and by source file
+  with globs, where * matches any run of characters and ? any one character;
+  --exclude and --exclude-source take tests back out. Each may be given more
+  than once. A test runs if it matches any include (or there are none) and
+  no exclude.
+
+  A GlobSet sorts its patterns when they are added. Patterns without
+  wildcards, and those whose only wildcard is one trailing *, the common
+  cases, go into a trie which is walked once per string. The rest are
+  matched one by one, in linear time and without allocating.
+  The runner evaluates the filters once per test and keeps the answers.
+*/
+
+namespace scope {
+  // * and ? only; no escapes or character classes
+  inline bool globMatch(const char* pattern, const char* str) {
+    const char* star = nullptr; // position in the pattern just after the last *
+    const char* resume = nullptr; // where in str that * began to match
+    while (*str) {
+      if (*pattern == '*') {
+        star = ++pattern;
+        resume = str;
+      }
+      else if (*pattern == '?' || *pattern == *str) {
+        ++pattern;
+        ++str;
+      }
+      else if (star) {
+        // let the last * swallow one more character, and retry from there
+        pattern = star;
+        str = ++resume;
+      }
+      else {
+        return false;
+      }
+    }
+    while (*pattern == '*') {
+      ++pattern;
+    }
+    return !*pattern;
+  }
+
+  class GlobSet {
+  public:
+    GlobSet(): Trie(1), NumPatterns(0) {}
+
+    void add(const std::string& pattern) {
+      const std::size_t wild = pattern.find_first_of("*?");
+      if (wild == std::string::npos) {
+        Trie[insert(pattern)].Exact = true;
+      }
+      else if (wild == pattern.size() - 1 && pattern[wild] == '*') {
+        Trie[insert(pattern.substr(0, wild))].Prefix = true;
+      }
+      else {
+        Globs.push_back(pattern);
+      }
+      ++NumPatterns;
+    }
+
+    bool empty() const {
+      return NumPatterns == 0;
+    }
+
+    bool matches(const std::string& str) const {
+      uint32_t node = 0;
+      for (std::size_t i = 0; ; ++i) {
+        const TrieNode& n(Trie[node]);
+        if (n.Prefix || (n.Exact && i == str.size())) {
+          return true;
+        }
+        if (i == str.size() || !(node = child(node, str[i]))) {
+          break;
+        }
+      }
+      for (const std::string& glob: Globs) {
+        if (globMatch(glob.c_str(), str.c_str())) {
+          return true;
+        }
+      }
+      return false;
+    }
+
+  private:
+    struct TrieNode {
+      TrieNode(): Exact(false), Prefix(false) {}
+
+      std::vector<std::pair<char, uint32_t>> Children; // sorted by char
+      bool Exact,  // a pattern ends here
+           Prefix; // a pattern ends here with a *
+    };
+
+    // 0, the root, for none
+    uint32_t child(uint32_t node, char c) const {
+      for (const auto& edge: Trie[node].Children) {
+        if (edge.first == c) {
+          return edge.second;
+        }
+        if (edge.first > c) {
+          break;
+        }
+      }
+      return 0;
+    }
+
+    uint32_t insert(const std::string& key) {
+      uint32_t node = 0;
+      for (char c: key) {
+        uint32_t next = child(node, c);
+        if (!next) {
+          next = static_cast<uint32_t>(Trie.size());
+          Trie.push_back(TrieNode());
+          auto& kids(Trie[node].Children);
+          auto pos = kids.begin();
+          while (pos != kids.end() && pos->first < c) {
+            ++pos;
+          }
+          kids.insert(pos, std::make_pair(c, next));
+        }
+        node = next;
+      }
+      return node;
+    }
+
+    std::vector<TrieNode>    Trie;
+    std::vector<std::string> Globs;
+    std::size_t              NumPatterns;
+  };
+}
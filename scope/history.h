@@ -0,0 +1,96 @@
+/*
+  © 2016, Jon Stewart
+  Released under the terms of the Boost license (http://www.boost.org/LICENSE_1_0.txt). See License.txt for details.
+*/
+
+#pragma once
+
+#include <cstdlib>
+#include <iomanip>
+#include <istream>
+#include <limits>
+#include <map>
+#include <ostream>
+#include <string>
+#include <utility>
+
+/**************************** Duration history *****************************
+
+  With --history, the runner remembers how long each test took, keyed by
+  source file and test name, in a small text file:
+
+    # scope duration history: seconds, source file, test name
+    0.01332	test4.cpp	benchmarkCalibration
+    ...
+
+  one tab-separated line per test. When tests run on several threads or in a
+  process pool, they are dispatched longest-first, so that the slow ones do
+  not start last and leave the other workers idle at the end of the run.
+  Tests missing from the history go first of all, since nothing is known
+  about them.
+
+  Durations are smoothed, new = (old + measured) / 2, so that one noisy run
+  does not reorder everything. Entries for tests which did not run this time
+  are kept, and so a filtered run does not forget the rest of the suite.
+*/
+
+namespace scope {
+  class DurationHistory {
+  public:
+    typedef std::pair<std::string, std::string> Key; // source file, test name
+
+    // returns false on a line that cannot be parsed; earlier lines are kept
+    bool load(std::istream& in) {
+      std::string line;
+      while (std::getline(in, line)) {
+        if (line.empty() || line[0] == '#') {
+          continue;
+        }
+        const std::size_t tab1 = line.find('\t'),
+                          tab2 = tab1 == std::string::npos ? tab1: line.find('\t', tab1 + 1);
+        if (tab2 == std::string::npos) {
+          return false;
+        }
+        const char* begin = line.c_str();
+        char* end;
+        const double seconds = std::strtod(begin, &end);
+        if (end != begin + tab1 || seconds < 0.0) {
+          return false;
+        }
+        Seconds[Key(line.substr(tab1 + 1, tab2 - tab1 - 1), line.substr(tab2 + 1))] = seconds;
+      }
+      return true;
+    }
+
+    void save(std::ostream& out) const {
+      out << "# scope duration history: seconds, source file, test name\n";
+      out << std::setprecision(6);
+      for (const auto& entry: Seconds) {
+        out << entry.second << '\t' << entry.first.first << '\t' << entry.first.second << '\n';
+      }
+    }
+
+    void record(const std::string& source, const std::string& name, double seconds) {
+      auto it = Seconds.find(Key(source, name));
+      if (it == Seconds.end()) {
+        Seconds.insert(std::make_pair(Key(source, name), seconds));
+      }
+      else {
+        it->second = (it->second + seconds) / 2;
+      }
+    }
+
+    // infinity for tests never seen, so that they sort first
+    double expected(const std::string& source, const std::string& name) const {
+      auto it = Seconds.find(Key(source, name));
+      return it == Seconds.end() ? std::numeric_limits<double>::infinity(): it->second;
+    }
+
+    bool empty() const {
+      return Seconds.empty();
+    }
+
+  private:
+    std::map<Key, double> Seconds;
+  };
+}
@@ -0,0 +1,605 @@
+/*
+  © 2016, Jon Stewart
+  Released under the terms of the Boost license (http://www.boost.org/LICENSE_1_0.txt). See License.txt for details.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <poll.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "test.h"
+#include "watchdog.h"
+
+/**************************** Process isolation *****************************
+
+  In isolated mode each test runs in a child process forked off the runner.
+  The child writes its TestResult to a pipe as a single record:
+
+    uint32 count, then count * failure:
+      string file, uint32 line, string message, string expected, string actual
+    uint32 count, then count * string warning
+    uint32 count, then count * (string name, double value)
+    double seconds
+
+  where a string is a uint32 length followed by that many bytes,
+  and exits with _exit(), so that no static destructors or atexit handlers
+  run twice. The parent reads the record and then reaps the child. If the
+  child dies before it finishes writing the record, the test is reported as
+  having crashed, along with the signal that killed it, and the run goes on.
+
+  Forking once per test is expensive for suites of tiny tests, so there is
+  also a ProcessPool: a fixed number of long-lived children, each of which
+  reads test indices (uint32) from a command pipe and answers each with
+
+    uint32 index, then the result record above
+
+  on its result pipe. The parent hands out small batches of indices in
+  the order given and waits on all the result pipes with poll(). When a child
+  dies, the first test of its batch is reported as crashed, the rest of the
+  batch goes back to the front of the queue, and a new child is forked.
+
+  The pool cannot tell exactly when a child starts on the next test of a
+  batch, so for timeouts it takes the time the previous result came in.
+  poll() waits no longer than the earliest such deadline, and a child whose
+  test overruns is killed and handled like any other that dies.
+*/
+
+namespace scope {
+  namespace {
+    bool writeAll(int fd, const void* buf, std::size_t len) {
+      const char* cur = static_cast<const char*>(buf);
+      while (len) {
+        const ssize_t n = ::write(fd, cur, len);
+        if (n < 0) {
+          if (errno == EINTR) {
+            continue;
+          }
+          return false;
+        }
+        cur += n;
+        len -= n;
+      }
+      return true;
+    }
+
+    // returns false on EOF or error before len bytes were read
+    bool readAll(int fd, void* buf, std::size_t len) {
+      char* cur = static_cast<char*>(buf);
+      while (len) {
+        const ssize_t n = ::read(fd, cur, len);
+        if (n < 0 && errno == EINTR) {
+          continue;
+        }
+        if (n <= 0) {
+          return false;
+        }
+        cur += n;
+        len -= n;
+      }
+      return true;
+    }
+
+    void appendU32(std::string& buf, uint32_t val) {
+      buf.append(reinterpret_cast<const char*>(&val), sizeof(val));
+    }
+
+    void appendString(std::string& buf, const std::string& str) {
+      appendU32(buf, static_cast<uint32_t>(str.size()));
+      buf.append(str);
+    }
+
+    void appendMessages(std::string& buf, const MessageList& messages) {
+      appendU32(buf, static_cast<uint32_t>(messages.size()));
+      for (const std::string& m: messages) {
+        appendString(buf, m);
+      }
+    }
+
+    std::string encodeResult(const TestResult& result) {
+      std::string buf;
+      appendU32(buf, static_cast<uint32_t>(result.Failures.size()));
+      for (const Failure& f: result.Failures) {
+        appendString(buf, f.File);
+        appendU32(buf, static_cast<uint32_t>(f.Line));
+        appendString(buf, f.Message);
+        appendString(buf, f.Expected);
+        appendString(buf, f.Actual);
+      }
+      appendMessages(buf, result.Warnings);
+      appendU32(buf, static_cast<uint32_t>(result.Metrics.size()));
+      for (const Metric& m: result.Metrics) {
+        appendString(buf, m.Name);
+        buf.append(reinterpret_cast<const char*>(&m.Value), sizeof(m.Value));
+      }
+      buf.append(reinterpret_cast<const char*>(&result.Seconds), sizeof(result.Seconds));
+      return buf;
+    }
+
+    bool readString(int fd, std::string& str) {
+      uint32_t len;
+      if (!readAll(fd, &len, sizeof(len))) {
+        return false;
+      }
+      str.assign(len, '\0');
+      return !len || readAll(fd, &str[0], len);
+    }
+
+    bool readMessages(int fd, MessageList& messages) {
+      uint32_t count;
+      if (!readAll(fd, &count, sizeof(count))) {
+        return false;
+      }
+      for (uint32_t i = 0; i < count; ++i) {
+        std::string m;
+        if (!readString(fd, m)) {
+          return false;
+        }
+        messages.push_back(std::move(m));
+      }
+      return true;
+    }
+
+    bool readResult(int fd, TestResult& result) {
+      uint32_t count;
+      if (!readAll(fd, &count, sizeof(count))) {
+        return false;
+      }
+      for (uint32_t i = 0; i < count; ++i) {
+        Failure f("");
+        uint32_t line;
+        if (!readString(fd, f.File) || !readAll(fd, &line, sizeof(line)) || !readString(fd, f.Message)
+          || !readString(fd, f.Expected) || !readString(fd, f.Actual))
+        {
+          return false;
+        }
+        f.Line = static_cast<int>(line);
+        result.Failures.push_back(std::move(f));
+      }
+      if (!readMessages(fd, result.Warnings)) {
+        return false;
+      }
+      if (!readAll(fd, &count, sizeof(count))) {
+        return false;
+      }
+      for (uint32_t i = 0; i < count; ++i) {
+        std::string name;
+        double val;
+        if (!readString(fd, name) || !readAll(fd, &val, sizeof(val))) {
+          return false;
+        }
+        result.Metrics.emplace_back(name, val);
+      }
+      return readAll(fd, &result.Seconds, sizeof(result.Seconds));
+    }
+
+    std::string describeExit(int status) {
+      std::ostringstream buf;
+      if (WIFSIGNALED(status)) {
+        const int sig = WTERMSIG(status);
+        buf << "crashed with signal " << sig << " (" << ::strsignal(sig) << ")";
+      }
+      else if (WIFEXITED(status)) {
+        buf << "exited with status " << WEXITSTATUS(status) << " before reporting results";
+      }
+      else {
+        buf << "ended abnormally";
+      }
+      return buf.str();
+    }
+
+    // Worker threads may fork concurrently. Every child would otherwise
+    // inherit the pipes of its siblings, and a parent would not see EOF on
+    // its pipe until all of them had exited. Pipes are therefore created and
+    // forked under a lock, and each child closes every fd registered here
+    // other than its own.
+    std::mutex& forkLock() {
+      static std::mutex lock;
+      return lock;
+    }
+
+    std::vector<int>& parentPipeFds() {
+      static std::vector<int> fds;
+      return fds;
+    }
+
+    void unregisterPipeFd(int fd) {
+      auto& fds(parentPipeFds());
+      fds.erase(std::remove(fds.begin(), fds.end(), fd), fds.end());
+    }
+
+    void closeSiblingPipes(int keep) {
+      for (int fd: parentPipeFds()) {
+        if (fd != keep) {
+          ::close(fd);
+        }
+      }
+    }
+
+    // fatal signals should kill the child outright, so the parent can report them
+    void prepareChild() {
+      std::signal(SIGSEGV, SIG_DFL);
+      std::signal(SIGFPE, SIG_DFL);
+    }
+
+    void flushForFork() {
+      std::cout.flush();
+      std::cerr.flush();
+      std::fflush(nullptr);
+    }
+
+    typedef std::function<void(const TestCase&, TestResult&)> InProcessRunner;
+
+    // the limit is in seconds, and 0 for none
+    double timeoutFor(const TestCase& test, double defaultTimeout) {
+      return test.Timeout > 0.0 ? test.Timeout: defaultTimeout;
+    }
+
+    void runIsolated(const TestCase& test, TestResult& result, const InProcessRunner& runInProcess,
+                     Watchdog* watchdog = nullptr, double timeout = 0.0)
+    {
+      int fds[2];
+      pid_t pid;
+      {
+        std::lock_guard<std::mutex> lock(forkLock());
+        if (::pipe(fds) != 0) {
+          result.testFailed(test, Failure(std::string("could not create pipe for isolated test: ") + std::strerror(errno)));
+          return;
+        }
+        flushForFork();
+        pid = ::fork();
+        if (pid == 0) {
+          ::close(fds[0]);
+          closeSiblingPipes(fds[1]);
+          prepareChild();
+          TestResult mine;
+          try {
+            runInProcess(test, mine);
+          }
+          catch (...) {
+            std::terminate();
+          }
+          const std::string record(encodeResult(mine));
+          ::_exit(writeAll(fds[1], record.data(), record.size()) ? 0: 1);
+        }
+        ::close(fds[1]);
+        if (pid < 0) {
+          ::close(fds[0]);
+          result.testFailed(test, Failure(std::string("could not fork isolated test: ") + std::strerror(errno)));
+          return;
+        }
+        parentPipeFds().push_back(fds[0]);
+      }
+
+      const bool timed = watchdog && timeout > 0.0;
+      const unsigned int alarm = timed ? watchdog->arm(test.Name, timeout, pid): 0;
+      const bool complete = readResult(fds[0], result);
+      const bool timedOut = timed && watchdog->disarm(alarm);
+      {
+        std::lock_guard<std::mutex> lock(forkLock());
+        unregisterPipeFd(fds[0]);
+        ::close(fds[0]);
+      }
+
+      int status = 0;
+      while (::waitpid(pid, &status, 0) < 0 && errno == EINTR) {
+        ;
+      }
+      if (!complete) {
+        result.testFailed(test, Failure(timedOut ? describeTimeout(timeout): describeExit(status)));
+      }
+    }
+
+    // receives each test's result in the parent, as it comes in
+    typedef std::function<void(const TestCase&, TestResult&)> ResultHandler;
+
+    class ProcessPool {
+    public:
+      // tests sorted longest-first want maxBatch 1, or the first worker gets all the long ones
+      ProcessPool(const std::vector<const TestCase*>& tests, const InProcessRunner& runInProcess,
+                  const ResultHandler& onResult, unsigned int numWorkers, std::size_t maxBatch = 32,
+                  double defaultTimeout = 0.0):
+        Tests(tests), RunInProcess(runInProcess), OnResult(onResult), Workers(std::min<std::size_t>(numWorkers, tests.size())),
+        MaxBatch(std::max<std::size_t>(1, maxBatch)), DefaultTimeout(defaultTimeout)
+      {
+        for (uint32_t i = 0; i < Tests.size(); ++i) {
+          Pending.push_back(i);
+        }
+      }
+
+      // errors of the pool itself go to sink.runError()
+      void run(ResultSink& sink) {
+        // a write to a dead child must show up as an error, not kill the runner
+        auto oldPipeHandler = std::signal(SIGPIPE, SIG_IGN);
+        for (Worker& w: Workers) {
+          if (!spawn(w, sink)) {
+            break;
+          }
+          dispatch(w);
+        }
+
+        std::vector<pollfd> polls;
+        while (busy()) {
+          polls.clear();
+          for (Worker& w: Workers) {
+            if (!w.Outstanding.empty()) {
+              pollfd p = {w.ResultFd, POLLIN, 0};
+              polls.push_back(p);
+            }
+          }
+          if (::poll(polls.data(), polls.size(), pollTimeout()) < 0) {
+            if (errno == EINTR) {
+              continue;
+            }
+            sink.runError(std::string("process pool: poll failed: ") + std::strerror(errno));
+            break;
+          }
+          killOverdue();
+          for (const pollfd& p: polls) {
+            if (p.revents) {
+              collect(workerFor(p.fd), sink);
+            }
+          }
+        }
+
+        for (Worker& w: Workers) {
+          shutdown(w);
+        }
+        failUnrun();
+        std::signal(SIGPIPE, oldPipeHandler);
+      }
+
+    private:
+      typedef std::chrono::steady_clock Clock;
+
+      struct Worker {
+        Worker(): Pid(-1), CmdFd(-1), ResultFd(-1), TimedOut(false) {}
+
+        pid_t Pid;
+        int   CmdFd,
+              ResultFd;
+        bool  TimedOut;
+        Clock::time_point    Started; // of the front outstanding test
+        std::deque<uint32_t> Outstanding;
+      };
+
+      double limitFor(const Worker& w) const {
+        return timeoutFor(*Tests[w.Outstanding.front()], DefaultTimeout);
+      }
+
+      Clock::time_point deadlineFor(const Worker& w) const {
+        return w.Started + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(limitFor(w)));
+      }
+
+      // milliseconds until the earliest deadline, or -1 to wait indefinitely
+      int pollTimeout() const {
+        bool any = false;
+        Clock::time_point next;
+        for (const Worker& w: Workers) {
+          if (w.Outstanding.empty() || w.TimedOut || limitFor(w) <= 0.0) {
+            continue;
+          }
+          const Clock::time_point deadline(deadlineFor(w));
+          if (!any || deadline < next) {
+            next = deadline;
+            any = true;
+          }
+        }
+        if (!any) {
+          return -1;
+        }
+        const auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(next - Clock::now()).count();
+        return static_cast<int>(std::max<long long>(0, std::min<long long>(ms + 1, 60 * 60 * 1000)));
+      }
+
+      void killOverdue() {
+        const Clock::time_point now = Clock::now();
+        for (Worker& w: Workers) {
+          if (w.Outstanding.empty() || w.TimedOut || limitFor(w) <= 0.0 || now < deadlineFor(w)) {
+            continue;
+          }
+          reportOverdue(Tests[w.Outstanding.front()]->Name, std::chrono::duration<double>(now - w.Started).count(),
+                        limitFor(w), "; killing it");
+          ::kill(w.Pid, SIGKILL);
+          w.TimedOut = true;
+        }
+      }
+
+      bool busy() const {
+        for (const Worker& w: Workers) {
+          if (!w.Outstanding.empty()) {
+            return true;
+          }
+        }
+        return false;
+      }
+
+      Worker& workerFor(int resultFd) {
+        for (Worker& w: Workers) {
+          if (w.ResultFd == resultFd) {
+            return w;
+          }
+        }
+        assert(!"no worker for result fd");
+        return Workers.front();
+      }
+
+      bool spawn(Worker& w, ResultSink& sink) {
+        int cmd[2], res[2];
+        if (::pipe(cmd) != 0) {
+          sink.runError(std::string("process pool: could not create pipe: ") + std::strerror(errno));
+          return false;
+        }
+        if (::pipe(res) != 0) {
+          sink.runError(std::string("process pool: could not create pipe: ") + std::strerror(errno));
+          ::close(cmd[0]);
+          ::close(cmd[1]);
+          return false;
+        }
+        flushForFork();
+        const pid_t pid = ::fork();
+        if (pid == 0) {
+          ::close(cmd[1]);
+          ::close(res[0]);
+          for (Worker& sibling: Workers) {
+            if (sibling.Pid > 0) {
+              ::close(sibling.CmdFd);
+              ::close(sibling.ResultFd);
+            }
+          }
+          prepareChild();
+          serve(cmd[0], res[1]);
+          ::_exit(0);
+        }
+        ::close(cmd[0]);
+        ::close(res[1]);
+        if (pid < 0) {
+          sink.runError(std::string("process pool: could not fork worker: ") + std::strerror(errno));
+          ::close(cmd[1]);
+          ::close(res[0]);
+          return false;
+        }
+        w.Pid = pid;
+        w.CmdFd = cmd[1];
+        w.ResultFd = res[0];
+        w.TimedOut = false;
+        return true;
+      }
+
+      void serve(int cmdFd, int resultFd) {
+        uint32_t index;
+        while (readAll(cmdFd, &index, sizeof(index))) {
+          TestResult mine;
+          try {
+            RunInProcess(*Tests[index], mine);
+          }
+          catch (...) {
+            std::terminate();
+          }
+          std::string record;
+          appendU32(record, index);
+          record.append(encodeResult(mine));
+          if (!writeAll(resultFd, record.data(), record.size())) {
+            break;
+          }
+        }
+      }
+
+      // small batches amortize the round trip without starving other workers at the end
+      void dispatch(Worker& w) {
+        if (w.Pid <= 0 || Pending.empty()) {
+          return;
+        }
+        const std::size_t batch = std::max<std::size_t>(1, std::min<std::size_t>(MaxBatch, Pending.size() / (4 * Workers.size())));
+        if (w.Outstanding.empty()) {
+          w.Started = Clock::now();
+        }
+        std::vector<uint32_t> indices;
+        for (std::size_t i = 0; i < batch && !Pending.empty(); ++i) {
+          indices.push_back(Pending.front());
+          w.Outstanding.push_back(Pending.front());
+          Pending.pop_front();
+        }
+        // if the child has died, the write fails and collect() sees EOF
+        writeAll(w.CmdFd, indices.data(), indices.size() * sizeof(uint32_t));
+      }
+
+      void collect(Worker& w, ResultSink& sink) {
+        uint32_t index;
+        TestResult result;
+        if (readAll(w.ResultFd, &index, sizeof(index)) && readResult(w.ResultFd, result)) {
+          assert(index == w.Outstanding.front());
+          w.Outstanding.pop_front();
+          w.Started = Clock::now();
+          OnResult(*Tests[index], result);
+          if (w.Outstanding.empty()) {
+            dispatch(w);
+          }
+          return;
+        }
+
+        const bool timedOut = w.TimedOut;
+        const int status = shutdown(w);
+        const TestCase& crashed(*Tests[w.Outstanding.front()]);
+        TestResult crash;
+        crash.testFailed(crashed, Failure(timedOut ? describeTimeout(limitFor(w)): describeExit(status)));
+        OnResult(crashed, crash);
+        w.Outstanding.pop_front();
+        Pending.insert(Pending.begin(), w.Outstanding.begin(), w.Outstanding.end());
+        w.Outstanding.clear();
+        if (Pending.empty()) {
+          return;
+        }
+        if (spawn(w, sink)) {
+          dispatch(w);
+        }
+        else {
+          // the requeued tests go to whichever workers are left, if any
+          for (Worker& other: Workers) {
+            if (other.Outstanding.empty()) {
+              dispatch(other);
+            }
+          }
+        }
+      }
+
+      // Tests left over when no worker can run them, e.g. because none
+      // could be spawned again after a crash, fail rather than vanish from
+      // the count.
+      void failUnrun() {
+        for (Worker& w: Workers) {
+          Pending.insert(Pending.end(), w.Outstanding.begin(), w.Outstanding.end());
+          w.Outstanding.clear();
+        }
+        for (uint32_t index: Pending) {
+          TestResult result;
+          result.testFailed(*Tests[index], Failure("not run: the process pool had no worker left to run it"));
+          OnResult(*Tests[index], result);
+        }
+        Pending.clear();
+      }
+
+      // closing the command pipe tells the child to exit
+      int shutdown(Worker& w) {
+        int status = 0;
+        if (w.Pid > 0) {
+          ::close(w.CmdFd);
+          ::close(w.ResultFd);
+          while (::waitpid(w.Pid, &status, 0) < 0 && errno == EINTR) {
+            ;
+          }
+        }
+        w.Pid = -1;
+        w.CmdFd = w.ResultFd = -1;
+        return status;
+      }
+
+      const std::vector<const TestCase*>& Tests;
+      InProcessRunner      RunInProcess;
+      ResultHandler        OnResult;
+      std::vector<Worker>  Workers;
+      std::size_t          MaxBatch;
+      double               DefaultTimeout;
+      std::deque<uint32_t> Pending;
+    };
+  }
+}
@@ -0,0 +1,188 @@
+/*
+  © 2016, Jon Stewart
+  Released under the terms of the Boost license (http://www.boost.org/LICENSE_1_0.txt). See License.txt for details.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/**************************** Hardware performance counters *****************************
+
+  PerfCounters wraps a perf_event_open() counter group for the calling
+  thread. The first counter that opens becomes the group leader, so all of
+  them are scheduled onto the PMU together and their deltas describe the same
+  stretch of execution. If the kernel multiplexes the group, the values are
+  scaled by time enabled over time running.
+
+  Counters are strictly best-effort. If perf_event_paranoid, a container or
+  the hardware denies a counter, it is left out; if none open, available()
+  is false and nothing is reported. Only names missing from the table below
+  are treated as errors. Off Linux, nothing is ever available.
+*/
+
+namespace scope {
+  struct CounterSpec {
+    const char* Name;
+    uint32_t    Type;
+    uint64_t    Config;
+  };
+
+#if defined(__linux__)
+  inline const std::vector<CounterSpec>& knownCounters() {
+    static const std::vector<CounterSpec> specs = {
+      {"cycles",           PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+      {"instructions",     PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+      {"cache-references", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES},
+      {"cache-misses",     PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+      {"branches",         PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_INSTRUCTIONS},
+      {"branch-misses",    PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+      {"l1d-misses",       PERF_TYPE_HW_CACHE,
+        PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+      {"llc-misses",       PERF_TYPE_HW_CACHE,
+        PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+      {"task-clock",       PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK},
+      {"page-faults",      PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS}
+    };
+    return specs;
+  }
+#else
+  inline const std::vector<CounterSpec>& knownCounters() {
+    static const std::vector<CounterSpec> specs;
+    return specs;
+  }
+#endif
+
+  inline const CounterSpec* findCounter(const std::string& name) {
+    for (const CounterSpec& spec: knownCounters()) {
+      if (name == spec.Name) {
+        return &spec;
+      }
+    }
+    return nullptr;
+  }
+
+  // splits "cycles,instructions" and checks every name; false if one is unknown
+  inline bool parseCounterList(const std::string& list, std::vector<std::string>& names, std::string& error) {
+    std::istringstream in(list);
+    std::string name;
+    while (std::getline(in, name, ',')) {
+      if (name.empty()) {
+        continue;
+      }
+      if (!findCounter(name)) {
+        error = "unknown counter '" + name + "'";
+        return false;
+      }
+      names.push_back(name);
+    }
+    return true;
+  }
+
+  class PerfCounters {
+  public:
+    PerfCounters() {}
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    ~PerfCounters() {
+      close();
+    }
+
+    void open(const std::vector<std::string>& names) {
+      close();
+#if defined(__linux__)
+      for (const std::string& name: names) {
+        const CounterSpec* spec = findCounter(name);
+        if (!spec) {
+          continue;
+        }
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = spec->Type;
+        attr.config = spec->Config;
+        attr.disabled = Fds.empty() ? 1: 0;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        const int leader = Fds.empty() ? -1: Fds.front();
+        const int fd = static_cast<int>(::syscall(__NR_perf_event_open, &attr, 0, -1, leader, 0));
+        if (fd >= 0) {
+          Fds.push_back(fd);
+          Names.push_back(spec->Name);
+        }
+      }
+#else
+      (void)names;
+#endif
+    }
+
+    bool available() const {
+      return !Fds.empty();
+    }
+
+    // the counters which actually opened, in the order of values from stop()
+    const std::vector<std::string>& names() const {
+      return Names;
+    }
+
+    void start() {
+#if defined(__linux__)
+      if (available()) {
+        ::ioctl(Fds.front(), PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ::ioctl(Fds.front(), PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+      }
+#endif
+    }
+
+    bool stop(std::vector<double>& values) {
+      values.clear();
+#if defined(__linux__)
+      if (!available()) {
+        return false;
+      }
+      ::ioctl(Fds.front(), PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+      // nr, time enabled, time running, then one value per counter
+      std::vector<uint64_t> buf(3 + Fds.size());
+      const ssize_t len = ::read(Fds.front(), buf.data(), buf.size() * sizeof(uint64_t));
+      if (len < static_cast<ssize_t>(3 * sizeof(uint64_t)) || buf[0] != Fds.size() || !buf[2]) {
+        return false;
+      }
+      const double scale = static_cast<double>(buf[1]) / buf[2];
+      for (std::size_t i = 0; i < Fds.size(); ++i) {
+        values.push_back(buf[3 + i] * scale);
+      }
+      return true;
+#else
+      return false;
+#endif
+    }
+
+  private:
+    void close() {
+#if defined(__linux__)
+      for (int fd: Fds) {
+        ::close(fd);
+      }
+#endif
+      Fds.clear();
+      Names.clear();
+    }
+
+    std::vector<int>         Fds;
+    std::vector<std::string> Names;
+  };
+}
@@ -0,0 +1,347 @@
+/*
+  © 2016, Jon Stewart
+  Released under the terms of the Boost license (http://www.boost.org/LICENSE_1_0.txt). See License.txt for details.
+*/
+
+#pragma once
+
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <limits>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "test.h"
+#include "baseline.h"
+
+/**************************** Machine-readable reporters *****************************
+
+  --reporter junit|jsonl|tap writes the results to --report-file, for CI
+  systems and dashboards, alongside the usual text on stdout. Every
+  reporter writes a test as soon as the runner hands it over and flushes
+  it, so a run that dies part of the way through still leaves the tests
+  before it on disk:
+
+    jsonl   one JSON object per line: {"type": "test", "name", "source",
+            "passed", "seconds", "failures": [...], "metrics": {...}}
+            for each test, {"type": "error", "message"} for errors outside
+            any test, and {"type": "summary", "tests", "failures"} last
+
+    junit   a <testsuite> of <testcase>s, with the source file as the
+            classname, failures as <failure>s and metrics as <property>s.
+            The closing tags are rewritten after every test, so the file
+            is well-formed XML whenever it is read
+
+    tap     TAP version 13, with failures and metrics in YAML blocks and
+            the plan at the end
+
+  Durations are in seconds. Benchmarks report their statistics as metrics,
+  e.g. mean-ns, median-ns, p99-ns and iterations.
+*/
+
+namespace scope {
+  class Reporter: public ResultSink {
+  public:
+    virtual ~Reporter() {}
+
+    virtual void testStarted(const TestCommon&) {
+      Failures.clear();
+      Metrics.clear();
+    }
+
+    virtual void testFailed(const TestCommon&, const Failure& failure) {
+      Failures.push_back(failure);
+    }
+
+    virtual void testMetrics(const TestCommon&, const MetricList& metrics) {
+      Metrics.insert(Metrics.end(), metrics.begin(), metrics.end());
+    }
+
+    virtual void runFinished() {}
+
+  protected:
+    // the current test's, between testStarted() and testFinished()
+    std::vector<Failure> Failures;
+    MetricList           Metrics;
+  };
+
+  // forwards every event to each of a number of sinks
+  class TeeSink: public ResultSink {
+  public:
+    void add(ResultSink& sink) {
+      Sinks.push_back(&sink);
+    }
+
+    virtual void testStarted(const TestCommon& test) {
+      for (ResultSink* s: Sinks) {
+        s->testStarted(test);
+      }
+    }
+
+    virtual void testFailed(const TestCommon& test, const Failure& failure) {
+      for (ResultSink* s: Sinks) {
+        s->testFailed(test, failure);
+      }
+    }
+
+    virtual void testMetrics(const TestCommon& test, const MetricList& metrics) {
+      for (ResultSink* s: Sinks) {
+        s->testMetrics(test, metrics);
+      }
+    }
+
+    virtual void testFinished(const TestCommon& test, double seconds, bool passed) {
+      for (ResultSink* s: Sinks) {
+        s->testFinished(test, seconds, passed);
+      }
+    }
+
+    virtual void runError(const std::string& message) {
+      for (ResultSink* s: Sinks) {
+        s->runError(message);
+      }
+    }
+
+  private:
+    std::vector<ResultSink*> Sinks;
+  };
+
+  // JSON has no infinities or NaNs
+  inline void writeJsonNumber(std::ostream& out, double val) {
+    if (std::isfinite(val)) {
+      out << val;
+    }
+    else {
+      out << "null";
+    }
+  }
+
+  class JsonLinesReporter: public Reporter {
+  public:
+    JsonLinesReporter(std::ostream& out): Out(out), NumTests(0), NumFailures(0) {
+      Out << std::setprecision(10);
+    }
+
+    virtual void testFinished(const TestCommon& test, double seconds, bool passed) {
+      ++NumTests;
+      NumFailures += passed ? 0: 1;
+      Out << "{\"type\": \"test\", \"name\": ";
+      writeJsonString(Out, test.Name);
+      Out << ", \"source\": ";
+      writeJsonString(Out, test.SourceFile);
+      Out << ", \"passed\": " << (passed ? "true": "false") << ", \"seconds\": ";
+      writeJsonNumber(Out, seconds);
+      Out << ", \"failures\": [";
+      for (std::size_t i = 0; i < Failures.size(); ++i) {
+        const Failure& f(Failures[i]);
+        Out << (i ? ", ": "") << "{\"file\": ";
+        writeJsonString(Out, f.File);
+        Out << ", \"line\": " << f.Line << ", \"message\": ";
+        writeJsonString(Out, f.Message);
+        if (!f.Expected.empty() || !f.Actual.empty()) {
+          Out << ", \"expected\": ";
+          writeJsonString(Out, f.Expected);
+          Out << ", \"actual\": ";
+          writeJsonString(Out, f.Actual);
+        }
+        Out << '}';
+      }
+      Out << "], \"metrics\": {";
+      for (std::size_t i = 0; i < Metrics.size(); ++i) {
+        Out << (i ? ", ": "");
+        writeJsonString(Out, Metrics[i].Name);
+        Out << ": ";
+        writeJsonNumber(Out, Metrics[i].Value);
+      }
+      Out << "}}" << std::endl;
+    }
+
+    virtual void runError(const std::string& message) {
+      ++NumFailures;
+      Out << "{\"type\": \"error\", \"message\": ";
+      writeJsonString(Out, message);
+      Out << '}' << std::endl;
+    }
+
+    virtual void runFinished() {
+      Out << "{\"type\": \"summary\", \"tests\": " << NumTests << ", \"failures\": " << NumFailures << '}' << std::endl;
+    }
+
+  private:
+    std::ostream& Out;
+    unsigned int  NumTests,
+                  NumFailures;
+  };
+
+  inline void writeXmlEscaped(std::ostream& out, const std::string& str) {
+    for (char c: str) {
+      switch (c) {
+        case '<':  out << "&lt;"; break;
+        case '>':  out << "&gt;"; break;
+        case '&':  out << "&amp;"; break;
+        case '"':  out << "&quot;"; break;
+        case '\'': out << "&apos;"; break;
+        default:
+          // control characters other than whitespace are not allowed in XML 1.0
+          if (static_cast<unsigned char>(c) >= 0x20 || c == '\n' || c == '\t' || c == '\r') {
+            out << c;
+          }
+          else {
+            out << '?';
+          }
+      }
+    }
+  }
+
+  class JunitReporter: public Reporter {
+  public:
+    JunitReporter(std::ostream& out): Out(out), Seekable(out.tellp() != std::streampos(-1)) {
+      Out << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<testsuites>\n<testsuite name=\"scope\">\n";
+      close();
+    }
+
+    virtual void testFinished(const TestCommon& test, double seconds, bool) {
+      Out << "  <testcase name=\"";
+      writeXmlEscaped(Out, test.Name);
+      Out << "\" classname=\"";
+      writeXmlEscaped(Out, test.SourceFile);
+      Out << "\" time=\"" << std::fixed << std::setprecision(6) << seconds << "\"";
+      Out.unsetf(std::ios::floatfield);
+      if (Failures.empty() && Metrics.empty()) {
+        Out << "/>\n";
+        close();
+        return;
+      }
+      Out << ">\n";
+      if (!Metrics.empty()) {
+        Out << "    <properties>\n";
+        for (const Metric& m: Metrics) {
+          Out << "      <property name=\"";
+          writeXmlEscaped(Out, m.Name);
+          Out << "\" value=\"" << std::setprecision(std::numeric_limits<double>::max_digits10) << m.Value << "\"/>\n";
+        }
+        Out << "    </properties>\n";
+      }
+      for (const Failure& f: Failures) {
+        Out << "    <failure message=\"";
+        writeXmlEscaped(Out, f.Message);
+        Out << "\" type=\"" << (f.File.empty() ? "exception": "assertion") << "\">";
+        if (!f.File.empty()) {
+          writeXmlEscaped(Out, f.File);
+          Out << ':' << f.Line << ": ";
+        }
+        writeXmlEscaped(Out, f.Message);
+        Out << "</failure>\n";
+      }
+      Out << "  </testcase>\n";
+      close();
+    }
+
+    virtual void runError(const std::string& message) {
+      Out << "  <testcase name=\"run\" classname=\"scope\">\n    <error message=\"";
+      writeXmlEscaped(Out, message);
+      Out << "\"/>\n  </testcase>\n";
+      close();
+    }
+
+    virtual void runFinished() {
+      if (!Seekable) {
+        Out << tail() << std::flush;
+      }
+    }
+
+  private:
+    static const char* tail() {
+      return "</testsuite>\n</testsuites>\n";
+    }
+
+    // Writes the closing tags, flushes, and backs up over them for the next
+    // test. A pipe cannot back up, so it only gets them at the end.
+    void close() {
+      if (Seekable) {
+        Out << tail() << std::flush;
+        Out.seekp(-static_cast<std::streamoff>(std::strlen(tail())), std::ios::cur);
+      }
+      else {
+        Out.flush();
+      }
+    }
+
+    std::ostream& Out;
+    bool          Seekable;
+  };
+
+  class TapReporter: public Reporter {
+  public:
+    TapReporter(std::ostream& out): Out(out), NumTests(0) {
+      Out << "TAP version 13" << std::endl;
+    }
+
+    virtual void testFinished(const TestCommon& test, double seconds, bool passed) {
+      Out << (passed ? "ok ": "not ok ") << ++NumTests << " - " << test.Name << '\n'
+          << "  ---\n"
+          << "  source: " << test.SourceFile << '\n'
+          << "  seconds: " << seconds << '\n';
+      if (!Failures.empty()) {
+        Out << "  failures:\n";
+        for (const Failure& f: Failures) {
+          Out << "    - message: ";
+          writeJsonString(Out, f.Message); // a double-quoted JSON string is also valid YAML
+          Out << '\n';
+          if (!f.File.empty()) {
+            Out << "      at: ";
+            writeJsonString(Out, f.File + ":" + std::to_string(f.Line));
+            Out << '\n';
+          }
+          if (!f.Expected.empty() || !f.Actual.empty()) {
+            Out << "      expected: ";
+            writeJsonString(Out, f.Expected);
+            Out << "\n      actual: ";
+            writeJsonString(Out, f.Actual);
+            Out << '\n';
+          }
+        }
+      }
+      if (!Metrics.empty()) {
+        Out << "  metrics:\n";
+        for (const Metric& m: Metrics) {
+          Out << "    " << m.Name << ": " << m.Value << '\n';
+        }
+      }
+      Out << "  ..." << std::endl;
+    }
+
+    virtual void runError(const std::string& message) {
+      Out << "not ok " << ++NumTests << " - ";
+      for (char c: message) {
+        Out << (c == '\n' ? ' ': c);
+      }
+      Out << std::endl;
+    }
+
+    virtual void runFinished() {
+      Out << "1.." << NumTests << std::endl;
+    }
+
+  private:
+    std::ostream& Out;
+    unsigned int  NumTests;
+  };
+
+  // nullptr for an unknown format
+  inline std::unique_ptr<Reporter> makeReporter(const std::string& format, std::ostream& out) {
+    if (format == "jsonl") {
+      return std::unique_ptr<Reporter>(new JsonLinesReporter(out));
+    }
+    if (format == "junit") {
+      return std::unique_ptr<Reporter>(new JunitReporter(out));
+    }
+    if (format == "tap") {
+      return std::unique_ptr<Reporter>(new TapReporter(out));
+    }
+    return nullptr;
+  }
+}
@@ -0,0 +1,78 @@
+/*
+  © 2016, Jon Stewart
+  Released under the terms of the Boost license (http://www.boost.org/LICENSE_1_0.txt). See License.txt for details.
+*/
+
+#pragma once
+
+#include <sys/resource.h>
+#include <sys/time.h>
+
+/**************************** Resource usage *****************************
+
+  ResourceUsage is a snapshot of getrusage() for the calling thread. The
+  runner takes one before and one after each test with --resource-report, and
+  reports the difference: CPU time, page faults and context switches. A test
+  that faults a lot is touching much more memory than it needs to, and one
+  with many voluntary context switches is blocking, usually on I/O or locks.
+
+  The runner takes the snapshots on the thread running the test, which in
+  isolated and pool mode is the child process's own, so the numbers describe
+  the test and not the fork around it.
+
+  ru_maxrss is the peak RSS of the whole process, even with RUSAGE_THREAD,
+  and it only ever grows. Its delta is therefore how far a test pushed the
+  peak, which is zero for tests that stay within what earlier tests used.
+  Without RUSAGE_THREAD (i.e., off Linux), the counts are for the whole
+  process, and are only meaningful when tests run one at a time.
+*/
+
+namespace scope {
+  struct ResourceUsage {
+    double UserMs,
+           SysMs;
+    long   MinorFaults,
+           MajorFaults,
+           VoluntarySwitches,
+           InvoluntarySwitches,
+           MaxRssKb;
+  };
+
+  inline double toMs(const timeval& tv) {
+    return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+  }
+
+  inline ResourceUsage threadResourceUsage() {
+    rusage ru;
+#if defined(RUSAGE_THREAD)
+    ::getrusage(RUSAGE_THREAD, &ru);
+#else
+    ::getrusage(RUSAGE_SELF, &ru);
+#endif
+    ResourceUsage usage;
+    usage.UserMs = toMs(ru.ru_utime);
+    usage.SysMs = toMs(ru.ru_stime);
+    usage.MinorFaults = ru.ru_minflt;
+    usage.MajorFaults = ru.ru_majflt;
+    usage.VoluntarySwitches = ru.ru_nvcsw;
+    usage.InvoluntarySwitches = ru.ru_nivcsw;
+#if defined(__APPLE__)
+    usage.MaxRssKb = ru.ru_maxrss / 1024; // bytes on macOS
+#else
+    usage.MaxRssKb = ru.ru_maxrss;
+#endif
+    return usage;
+  }
+
+  inline ResourceUsage operator-(const ResourceUsage& after, const ResourceUsage& before) {
+    ResourceUsage diff;
+    diff.UserMs = after.UserMs - before.UserMs;
+    diff.SysMs = after.SysMs - before.SysMs;
+    diff.MinorFaults = after.MinorFaults - before.MinorFaults;
+    diff.MajorFaults = after.MajorFaults - before.MajorFaults;
+    diff.VoluntarySwitches = after.VoluntarySwitches - before.VoluntarySwitches;
+    diff.InvoluntarySwitches = after.InvoluntarySwitches - before.InvoluntarySwitches;
+    diff.MaxRssKb = after.MaxRssKb - before.MaxRssKb;
+    return diff;
+  }
+}
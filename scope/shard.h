@@ -0,0 +1,80 @@
+/*
+  © 2016, Jon Stewart
+  Released under the terms of the Boost license (http://www.boost.org/LICENSE_1_0.txt). See License.txt for details.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**************************** Sharding *****************************
+
+  --shard-index i --total-shards n runs only the i-th of n disjoint parts of
+  the suite, so that CI can spread a suite over several machines. Every
+  shard must agree on who runs what without talking to the others, so the
+  assignment depends only on the tests' source files and names, never on
+  the order in which static initialization happened to register them.
+
+  By default, a test belongs to shard fnv1a(source file, name) % n. That
+  is stable as tests come and go, but only balanced by count. With
+  --shard-history file, planShards() packs tests greedily, longest first,
+  onto whichever shard has the least work so far; tests missing from the
+  history count as the average of those present. The file is only read,
+  never updated, and every shard must be given the same one, e.g. a CI
+  artifact saved by an earlier --history run. The --history file itself is
+  not used for sharding: each shard records only its own tests in it, so
+  the copies on different machines drift apart, and the shards' plans
+  would drop some tests and run others twice.
+*/
+
+namespace scope {
+  inline uint64_t shardHash(const std::string& source, const std::string& name) {
+    uint64_t hash = 14695981039346656037ull;
+    auto mix = [&hash](unsigned char c) {
+      hash ^= c;
+      hash *= 1099511628211ull;
+    };
+    for (char c: source) {
+      mix(c);
+    }
+    mix(0);
+    for (char c: name) {
+      mix(c);
+    }
+    return hash;
+  }
+
+  struct ShardItem {
+    std::string SourceFile,
+                Name;
+    double      Cost;
+  };
+
+  // assigns each item a shard in [0, numShards); the result is indexed like items
+  inline std::vector<unsigned int> planShards(const std::vector<ShardItem>& items, unsigned int numShards) {
+    std::vector<std::size_t> order(items.size());
+    for (std::size_t i = 0; i < order.size(); ++i) {
+      order[i] = i;
+    }
+    // costliest first, ties in canonical order, so that every shard computes the same plan
+    std::sort(order.begin(), order.end(), [&items](std::size_t a, std::size_t b) {
+      const ShardItem& x(items[a]);
+      const ShardItem& y(items[b]);
+      if (x.Cost != y.Cost) {
+        return x.Cost > y.Cost;
+      }
+      return x.SourceFile != y.SourceFile ? x.SourceFile < y.SourceFile: x.Name < y.Name;
+    });
+    std::vector<double> load(std::max(1u, numShards), 0.0);
+    std::vector<unsigned int> shards(items.size());
+    for (std::size_t i: order) {
+      const unsigned int lightest = static_cast<unsigned int>(std::min_element(load.begin(), load.end()) - load.begin());
+      shards[i] = lightest;
+      load[lightest] += items[i].Cost;
+    }
+    return shards;
+  }
+}
@@ -0,0 +1,209 @@
+/*
+  © 2016, Jon Stewart
+  Released under the terms of the Boost license (http://www.boost.org/LICENSE_1_0.txt). See License.txt for details.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <utility>
+#include <vector>
+
+/**************************** Sample statistics *****************************
+
+  analyzeSamples() summarizes the raw timings of a benchmark. It works in
+  place on a caller-provided buffer, so that the analysis of one benchmark
+  does no allocation of its own:
+
+    [0, n)                    the samples; sorted on return
+    [n, 2n)                   scratch for absolute deviations (MAD)
+    [2n, 2n + resamples)      scratch for bootstrap means
+
+  bufferSize() gives the size to preallocate before sampling starts.
+
+  Percentiles interpolate linearly between closest ranks. The confidence
+  interval for the mean is a percentile bootstrap with a fixed seed, so the
+  same samples always yield the same interval. Outliers are classified with
+  Tukey's fences: mild beyond 1.5 IQR from the quartiles, severe beyond 3.
+
+  mannWhitneyGreater() compares two sets of samples without assuming they
+  are normally distributed, which timings rarely are. It returns the
+  one-sided p-value, by normal approximation with tie and continuity
+  corrections, for the hypothesis that the second set tends to be larger.
+*/
+
+namespace scope {
+  struct SampleStats {
+    SampleStats():
+      N(0), Mean(0.0), StdDev(0.0), Median(0.0), Mad(0.0), Min(0.0), Max(0.0),
+      P90(0.0), P99(0.0), CiLow(0.0), CiHigh(0.0), Confidence(0.0),
+      LowSevere(0), LowMild(0), HighMild(0), HighSevere(0) {}
+
+    std::size_t N;
+    double Mean,
+           StdDev,
+           Median,
+           Mad,
+           Min,
+           Max,
+           P90,
+           P99,
+           CiLow,
+           CiHigh,
+           Confidence;
+    unsigned int LowSevere,
+                 LowMild,
+                 HighMild,
+                 HighSevere;
+
+    unsigned int outliers() const {
+      return LowSevere + LowMild + HighMild + HighSevere;
+    }
+  };
+
+  struct StatsOptions {
+    StatsOptions(): Resamples(1000), Confidence(0.95), Seed(5489u) {}
+
+    std::size_t Resamples;
+    double      Confidence;
+    uint32_t    Seed;
+  };
+
+  inline std::size_t bufferSize(std::size_t n, const StatsOptions& opts) {
+    return 2 * n + opts.Resamples;
+  }
+
+  // p in [0, 1], over a sorted, non-empty range
+  inline double percentile(const double* sorted, std::size_t n, double p) {
+    const double rank = p * (n - 1);
+    const std::size_t lo = static_cast<std::size_t>(std::floor(rank));
+    const std::size_t hi = std::min(lo + 1, n - 1);
+    return sorted[lo] + (sorted[hi] - sorted[lo]) * (rank - lo);
+  }
+
+  inline double mean(const double* vals, std::size_t n) {
+    double sum = 0.0;
+    for (std::size_t i = 0; i < n; ++i) {
+      sum += vals[i];
+    }
+    return n ? sum / n: 0.0;
+  }
+
+  inline SampleStats analyzeSamples(double* buf, std::size_t n, const StatsOptions& opts = StatsOptions()) {
+    SampleStats stats;
+    stats.N = n;
+    if (!n) {
+      return stats;
+    }
+    double* samples = buf;
+    double* deviations = buf + n;
+    double* means = buf + 2 * n;
+
+    std::sort(samples, samples + n);
+    stats.Min = samples[0];
+    stats.Max = samples[n - 1];
+    stats.Mean = mean(samples, n);
+    stats.Median = percentile(samples, n, 0.5);
+    stats.P90 = percentile(samples, n, 0.9);
+    stats.P99 = percentile(samples, n, 0.99);
+
+    double sumSq = 0.0;
+    for (std::size_t i = 0; i < n; ++i) {
+      sumSq += (samples[i] - stats.Mean) * (samples[i] - stats.Mean);
+      deviations[i] = std::abs(samples[i] - stats.Median);
+    }
+    stats.StdDev = n > 1 ? std::sqrt(sumSq / (n - 1)): 0.0;
+    std::sort(deviations, deviations + n);
+    stats.Mad = percentile(deviations, n, 0.5);
+
+    const double q1 = percentile(samples, n, 0.25),
+                 q3 = percentile(samples, n, 0.75),
+                 iqr = q3 - q1;
+    for (std::size_t i = 0; i < n; ++i) {
+      const double x = samples[i];
+      if (x < q1 - 3 * iqr) {
+        ++stats.LowSevere;
+      }
+      else if (x < q1 - 1.5 * iqr) {
+        ++stats.LowMild;
+      }
+      else if (x > q3 + 3 * iqr) {
+        ++stats.HighSevere;
+      }
+      else if (x > q3 + 1.5 * iqr) {
+        ++stats.HighMild;
+      }
+    }
+
+    stats.Confidence = opts.Confidence;
+    if (opts.Resamples) {
+      std::mt19937 rng(opts.Seed);
+      std::uniform_int_distribution<std::size_t> pick(0, n - 1);
+      for (std::size_t r = 0; r < opts.Resamples; ++r) {
+        double sum = 0.0;
+        for (std::size_t i = 0; i < n; ++i) {
+          sum += samples[pick(rng)];
+        }
+        means[r] = sum / n;
+      }
+      std::sort(means, means + opts.Resamples);
+      const double tail = (1.0 - opts.Confidence) / 2;
+      stats.CiLow = percentile(means, opts.Resamples, tail);
+      stats.CiHigh = percentile(means, opts.Resamples, 1.0 - tail);
+    }
+    else {
+      stats.CiLow = stats.CiHigh = stats.Mean;
+    }
+    return stats;
+  }
+
+  inline double mannWhitneyGreater(const std::vector<double>& base, const std::vector<double>& cur) {
+    const std::size_t n1 = cur.size(),
+                      n2 = base.size(),
+                      n = n1 + n2;
+    if (!n1 || !n2) {
+      return 1.0;
+    }
+    // (value, from cur)
+    std::vector<std::pair<double, bool>> all;
+    all.reserve(n);
+    for (double x: cur) {
+      all.emplace_back(x, true);
+    }
+    for (double x: base) {
+      all.emplace_back(x, false);
+    }
+    std::sort(all.begin(), all.end());
+
+    double rankSum = 0.0,
+           tieTerm = 0.0;
+    for (std::size_t i = 0; i < n;) {
+      std::size_t j = i;
+      while (j < n && all[j].first == all[i].first) {
+        ++j;
+      }
+      const double avgRank = (i + 1 + j) / 2.0,
+                   t = static_cast<double>(j - i);
+      tieTerm += t * t * t - t;
+      for (std::size_t k = i; k < j; ++k) {
+        if (all[k].second) {
+          rankSum += avgRank;
+        }
+      }
+      i = j;
+    }
+
+    const double u = rankSum - n1 * (n1 + 1) / 2.0,
+                 mu = n1 * n2 / 2.0,
+                 sigma = std::sqrt(n1 * n2 / 12.0 * ((n + 1) - tieTerm / (static_cast<double>(n) * (n - 1))));
+    if (sigma == 0.0) {
+      return 1.0;
+    }
+    const double z = (u - mu - 0.5) / sigma;
+    return 0.5 * std::erfc(z / std::sqrt(2.0));
+  }
+}
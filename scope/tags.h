@@ -0,0 +1,268 @@
+/*
+  © 2016, Jon Stewart
+  Released under the terms of the Boost license (http://www.boost.org/LICENSE_1_0.txt). See License.txt for details.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+/**************************** Tags *****************************
+
+  SCOPE_TEST_TAGS(name, "slow, io") and SCOPE_FIXTURE_TAGS(name, fixture,
+  "io") tag a test, and --tags selects tests with an expression over the
+  tags, e.g. --tags 'fast & !io', using &, |, ! and parentheses. Benchmarks
+  are tagged "bench".
+
+  Each distinct tag is interned, at registration, as one bit of a 64-bit
+  mask, so a test's tags are a single word and an expression compiles to a
+  few word operations per test. Interning keeps pointers to the tag
+  strings, which are literals, and so does not allocate before main(). A
+  binary may use at most 64 distinct tags; past that, the runner refuses
+  to start.
+*/
+
+namespace scope {
+  struct TagTable {
+    enum {
+      MaxTags = 64
+    };
+
+    const char*  Names[MaxTags]; // not terminated; see Lengths
+    std::size_t  Lengths[MaxTags];
+    unsigned int Count;
+    bool         Overflowed;
+  };
+
+  // zero-initialized, and filled in during static initialization
+  inline TagTable& tagTable() {
+    static TagTable table;
+    return table;
+  }
+
+  inline bool isTagChar(char c) {
+    return std::isalnum(static_cast<unsigned char>(c)) || c == '_' || c == '-' || c == '.';
+  }
+
+  // the bit for the name, or 0 if it is unknown and insert is false (or the table is full)
+  inline uint64_t tagBit(const char* name, std::size_t len, bool insert) {
+    TagTable& table(tagTable());
+    for (unsigned int i = 0; i < table.Count; ++i) {
+      if (table.Lengths[i] == len && std::memcmp(table.Names[i], name, len) == 0) {
+        return uint64_t(1) << i;
+      }
+    }
+    if (!insert) {
+      return 0;
+    }
+    if (table.Count == TagTable::MaxTags) {
+      table.Overflowed = true;
+      return 0;
+    }
+    table.Names[table.Count] = name;
+    table.Lengths[table.Count] = len;
+    return uint64_t(1) << table.Count++;
+  }
+
+  // "slow, io" -> the mask of those tags, interning any new ones; tags must outlive the table, as literals do
+  inline uint64_t internTags(const char* tags) {
+    uint64_t mask = 0;
+    while (*tags) {
+      if (isTagChar(*tags)) {
+        const char* begin = tags;
+        while (isTagChar(*tags)) {
+          ++tags;
+        }
+        mask |= tagBit(begin, tags - begin, true);
+      }
+      else {
+        ++tags;
+      }
+    }
+    return mask;
+  }
+
+  // "slow,io"
+  inline std::string tagNames(uint64_t mask) {
+    const TagTable& table(tagTable());
+    std::string names;
+    for (unsigned int i = 0; i < table.Count; ++i) {
+      if (mask & (uint64_t(1) << i)) {
+        names += names.empty() ? "": ",";
+        names.append(table.Names[i], table.Lengths[i]);
+      }
+    }
+    return names;
+  }
+
+  // A --tags expression, compiled to postfix. matches() keeps its operand
+  // stack in the bits of a word, so it needs no memory of its own.
+  class TagExpression {
+  public:
+    TagExpression(): Expr(nullptr), Pos(0) {}
+
+    bool empty() const {
+      return Code.empty();
+    }
+
+    // false, with a message, if the expression is malformed
+    bool parse(const std::string& expr, std::string& error) {
+      Code.clear();
+      Unknown.clear();
+      Expr = expr.c_str();
+      Pos = 0;
+      Error.clear();
+      if (!parseOr() || !expect('\0')) {
+        error = Error.empty() ? "unexpected '" + std::string(1, Expr[Pos]) + "' in tag expression": Error;
+        Code.clear();
+        return false;
+      }
+      // each operand pushes one; each binary operator pops one
+      int depth = 0,
+          maxDepth = 0;
+      for (const Op& op: Code) {
+        depth += op.Kind == Op::Test ? 1: (op.Kind == Op::Not ? 0: -1);
+        maxDepth = std::max(maxDepth, depth);
+      }
+      if (maxDepth > 64) {
+        error = "tag expression is nested too deeply";
+        Code.clear();
+        return false;
+      }
+      return true;
+    }
+
+    // tags named in the expression that no test has; they are never set
+    const std::vector<std::string>& unknown() const {
+      return Unknown;
+    }
+
+    bool matches(uint64_t tags) const {
+      uint64_t stack = 0;
+      for (const Op& op: Code) {
+        switch (op.Kind) {
+          case Op::Test:
+            stack = (stack << 1) | ((tags & op.Mask) ? 1: 0);
+            break;
+          case Op::Not:
+            stack ^= 1;
+            break;
+          case Op::And:
+            stack = (stack >> 1) & (stack | ~uint64_t(1));
+            break;
+          case Op::Or:
+            stack = (stack >> 1) | (stack & 1);
+            break;
+        }
+      }
+      return Code.empty() || (stack & 1);
+    }
+
+  private:
+    struct Op {
+      enum Kinds { Test, Not, And, Or };
+
+      Kinds    Kind;
+      uint64_t Mask;
+    };
+
+    void skipSpace() {
+      while (Expr[Pos] == ' ' || Expr[Pos] == '\t') {
+        ++Pos;
+      }
+    }
+
+    bool expect(char c) {
+      skipSpace();
+      if (Expr[Pos] != c) {
+        return false;
+      }
+      if (c) {
+        ++Pos;
+      }
+      return true;
+    }
+
+    bool parseOr() {
+      if (!parseAnd()) {
+        return false;
+      }
+      skipSpace();
+      while (Expr[Pos] == '|') {
+        ++Pos;
+        if (!parseAnd()) {
+          return false;
+        }
+        Code.push_back(Op{Op::Or, 0});
+        skipSpace();
+      }
+      return true;
+    }
+
+    bool parseAnd() {
+      if (!parseNot()) {
+        return false;
+      }
+      skipSpace();
+      while (Expr[Pos] == '&') {
+        ++Pos;
+        if (!parseNot()) {
+          return false;
+        }
+        Code.push_back(Op{Op::And, 0});
+        skipSpace();
+      }
+      return true;
+    }
+
+    bool parseNot() {
+      skipSpace();
+      if (Expr[Pos] == '!') {
+        ++Pos;
+        if (!parseNot()) {
+          return false;
+        }
+        Code.push_back(Op{Op::Not, 0});
+        return true;
+      }
+      if (Expr[Pos] == '(') {
+        ++Pos;
+        if (!parseOr()) {
+          return false;
+        }
+        if (!expect(')')) {
+          Error = "missing ')' in tag expression";
+          return false;
+        }
+        return true;
+      }
+      const std::size_t begin = Pos;
+      while (isTagChar(Expr[Pos])) {
+        ++Pos;
+      }
+      if (Pos == begin) {
+        Error = Expr[Pos] ? "expected a tag at '" + std::string(Expr + Pos) + "'": "tag expression ends early";
+        return false;
+      }
+      const uint64_t bit = tagBit(Expr + begin, Pos - begin, false);
+      if (!bit) {
+        Unknown.push_back(std::string(Expr + begin, Pos - begin));
+      }
+      Code.push_back(Op{Op::Test, bit});
+      return true;
+    }
+
+    std::vector<Op>          Code;
+    std::vector<std::string> Unknown;
+
+    // parser state
+    const char*              Expr;
+    std::size_t              Pos;
+    std::string              Error;
+  };
+}
@@ -9,17 +9,93 @@
 #include <stdexcept>
 #include <sstream>
 #include <list>
+#include <vector>
 #include <functional>
-#include <regex>
+#include <atomic>
+#include <memory>
+#include <mutex>
 #include <type_traits>
+#include <iterator>
+#include <utility>
 // #include <iostream>
 
+#include "allocations.h"
+#include "arena.h"
+#include "tags.h"
+
 
 namespace scope {
-  typedef std::list<std::string> MessageList; // need to replace this with an output iterator
+  typedef std::list<std::string> MessageList;
   typedef std::function<void()> TestFunction;
 
-  void runFunction(TestFunction test, const char* testname, bool shouldFail, MessageList& messages);
+  // a named measurement of a test run, e.g. a hardware counter delta
+  struct Metric {
+    Metric(const std::string& name, double value): Name(name), Value(value) {}
+
+    std::string Name;
+    double      Value;
+  };
+
+  typedef std::vector<Metric> MetricList;
+
+  // one failed assertion, or an exception escaping a test; File is empty for the latter
+  struct Failure {
+    Failure(const std::string& message, const std::string& file = "", int line = 0):
+      File(file), Line(line), Message(message) {}
+
+    std::string File;
+    int         Line;
+    std::string Message,
+                Expected, // set by SCOPE_ASSERT_EQUAL
+                Actual;
+  };
+
+  struct TestCommon;
+
+/**************************** Result sinks *****************************
+
+  Tests report into a ResultSink as they run, rather than into a list
+  which is printed once the whole run is over. A test's failures go to
+  testFailed() as they are caught; the runner brackets them with
+  testStarted() and testFinished(), passes any measurements of the test
+  to testMetrics() in between, and sends errors which belong to no test,
+  e.g. a benchmark regression, to runError().
+
+  Tests on different threads or in different processes report into a
+  TestResult of their own first, and the runner passes each one on to its
+  sinks as a whole when the test is done. The events of one test are
+  therefore never interleaved with another's, and the only things kept for
+  the length of the run are counts.
+*/
+  class ResultSink {
+  public:
+    virtual ~ResultSink() {}
+
+    virtual void testStarted(const TestCommon&) {}
+    virtual void testFailed(const TestCommon& test, const Failure& failure) = 0;
+    virtual void testMetrics(const TestCommon&, const MetricList&) {}
+    virtual void testFinished(const TestCommon&, double /* seconds */, bool /* passed */) {}
+    virtual void runError(const std::string&) {}
+  };
+
+  struct TestResult: public ResultSink {
+    TestResult(): Seconds(0.0) {}
+
+    virtual void testFailed(const TestCommon&, const Failure& failure) {
+      Failures.push_back(failure);
+    }
+
+    bool passed() const {
+      return Failures.empty();
+    }
+
+    std::vector<Failure> Failures;
+    MessageList Warnings; // reported, but do not fail the test
+    MetricList  Metrics;
+    double      Seconds;  // wall time of the test body; 0 if it never finished
+  };
+
+  void runFunction(const TestFunction& test, const TestCommon& info, bool shouldFail, ResultSink& sink);
   void caughtBadExceptionType(const std::string& testname, const std::string& msg);
 
   class TestFailure: public std::runtime_error {
@@ -31,6 +107,8 @@ namespace scope {
 
     std::string File;
     int Line;
+    std::string Expected,
+                Actual;
   };
 
   template<typename ExceptionType>
@@ -46,6 +124,32 @@ namespace scope {
     return out;
   }
 
+  inline Failure failureOf(const TestFailure& fail) {
+    Failure f(fail.what(), fail.File, fail.Line);
+    f.Expected = fail.Expected;
+    f.Actual = fail.Actual;
+    return f;
+  }
+
+  // SCOPE_ASSERT_EQUAL() keeps the operands as strings, for reporters which want them apart
+  template<typename ExceptionType>
+  void attachOperands(ExceptionType&, const std::string&, const std::string&) {}
+
+  inline void attachOperands(TestFailure& fail, const std::string& expected, const std::string& actual) {
+    fail.Expected = expected;
+    fail.Actual = actual;
+  }
+
+  template<typename ExceptionType, typename ExpectedT, typename ActualT>
+  [[noreturn]] void throwUnequal(const char* const file, int line, const std::string& message, const ExpectedT& e, const ActualT& a) {
+    std::ostringstream expected, actual;
+    expected << e;
+    actual << a;
+    ExceptionType fail(file, line, message.c_str());
+    attachOperands(fail, expected.str(), actual.str());
+    throw fail;
+  }
+
 /**************************** evalEqual mechanics *****************************
 
   There are several different template functions for evalEqual(). They are used
@@ -77,7 +181,7 @@ namespace scope {
         buf << msg << " ";
       }
       buf << "Expected: null, Actual: " << a;
-      throw ExceptionType(file, line, buf.str().c_str());
+      throwUnequal<ExceptionType>(file, line, buf.str(), "null", a);
     }
   }
 
@@ -92,7 +196,7 @@ namespace scope {
         buf << msg << " ";
       }
       buf << "Expected: " << e << ", Actual: " << a;
-      throw ExceptionType(file, line, buf.str().c_str());
+      throwUnequal<ExceptionType>(file, line, buf.str(), e, a);
     }
   }
 
@@ -118,30 +222,28 @@ namespace scope {
         buf << msg << " ";
       }
 
-      buf << "Mismatch at index "
-          << std::distance(ebeg, mis.first)
-          << ". Expected: ";
-
+      std::ostringstream expected, actual;
       if (mis.first == eend) {
-        buf << "*past end*";
+        expected << "*past end*";
       }
       else {
-        buf << *mis.first;
+        expected << *mis.first;
       }
-
-      buf << ", Actual: ";
-
       if (mis.second == aend) {
-        buf << "*past end*";
+        actual << "*past end*";
       }
       else {
-        buf << *mis.second;
+        actual << *mis.second;
       }
 
-      buf << ", Expected size: " << std::distance(ebeg, eend)
+      buf << "Mismatch at index "
+          << std::distance(ebeg, mis.first)
+          << ". Expected: " << expected.str()
+          << ", Actual: " << actual.str()
+          << ", Expected size: " << std::distance(ebeg, eend)
           << ", Actual size: " << std::distance(abeg, aend);
 
-      throw ExceptionType(file, line, buf.str().c_str());
+      throwUnequal<ExceptionType>(file, line, buf.str(), expected.str(), actual.str());
     }
   }
 
@@ -245,7 +347,7 @@ namespace scope {
         buf << msg << ". ";
       }
       buf << "Expected: " << e << ", Actual: " << a << '.';
-      throw ExceptionType(file, line, buf.str().c_str());
+      throwUnequal<ExceptionType>(file, line, buf.str(), e, a);
     }
   }
 
@@ -306,41 +408,94 @@ namespace scope {
   }
 
 
-/**************************** Test types *****************************/
+/**************************** Test types *****************************
+
+  The objects that SCOPE_TEST and friends create at static-init time are the
+  tests themselves: the runner calls Run() directly on the registration
+  record, so running a test allocates nothing beyond what the test does.
+  BoundTest, FixtureTest and BenchmarkCase can also be created on their own,
+  without registering them, to run a test by hand.
+*/
+  // The name and source are not copied, so that registering a test does not
+  // allocate before main(); they must outlive the test, as literals do.
   struct TestCommon {
-    TestCommon(const std::string& name, const std::string& source):
-      Name(name), SourceFile(source) {}
+    TestCommon(const char* name, const char* source, double timeout = 0.0):
+      Name(name), SourceFile(source), Timeout(timeout) {}
 
     virtual ~TestCommon() {}
 
-    std::string Name,
-                SourceFile;
+    const char* Name;
+    const char* SourceFile;
+    double      Timeout; // seconds; 0 for the runner's default
   };
 
   class TestCase: public TestCommon {
   public:
-    TestCase(const std::string& name, const std::string& source): TestCommon(name, source) {}
+    TestCase(const char* name, const char* source, double timeout = 0.0): TestCommon(name, source, timeout) {}
     virtual ~TestCase() {}
 
-    void Run(MessageList& messages) const {
-      _Run(messages);
+    void Run(ResultSink& sink) const {
+      _Run(sink);
     }
 
+    // true if the runner must give the test a child process of its own, even without -i
+    virtual bool needsOwnProcess() const { return false; }
+
   private:
-    virtual void _Run(MessageList& messages) const = 0;
+    virtual void _Run(ResultSink& sink) const = 0;
   };
 
-  class BoundTest: public TestCase {
+  template<class T> class Node {
+  public:
+    Node(): Next(nullptr), FirstChild(nullptr) {}
+
+    void insert(T& node) {
+      node.Next = FirstChild;
+      FirstChild = &node;
+    }
+
+    T*  Next;
+    T*  FirstChild;
+  };
+
+  class SharedFixtureBase;
+
+  // a test which can be linked into TestRunner::root()
+  class AutoRegister: public TestCase, public Node<AutoRegister> {
+  public:
+    int      Line; // of the registration, which places the test in its suite; 0 if unknown
+    uint64_t Tags; // see internTags()
+
+    AutoRegister(const char* name, const char* source, double timeout = 0.0, int line = 0, uint64_t tags = 0):
+      TestCase(name, source, timeout), Line(line), Tags(tags) {}
+
+    virtual ~AutoRegister() {}
+
+    // benchmarks are skipped by test runs, and only run with --bench
+    virtual bool isBenchmark() const { return false; }
+
+    // Tests in one suite whose sharedFixtureKey()s are equal share a
+    // fixture; the runner has each adopt the first one's.
+    virtual const void* sharedFixtureKey() const { return nullptr; }
+    virtual void shareFixtureWith(AutoRegister&) {}
+    virtual SharedFixtureBase* sharedFixture() const { return nullptr; }
+
+    // A test which stands for several, like SCOPE_TEST_PARAM's, adds them
+    // to cases and returns true; the runner runs them in its place.
+    virtual bool expand(std::vector<std::unique_ptr<AutoRegister>>&) const { return false; }
+  };
+
+  class BoundTest: public AutoRegister {
   public:
     TestFunction Fn;
     bool         ShouldFail;
 
-    BoundTest(const std::string& name, const std::string& source, TestFunction fn, bool shouldFail):
-      TestCase(name, source), Fn(fn), ShouldFail(shouldFail) {}
+    BoundTest(const char* name, const char* source, const TestFunction& fn, bool shouldFail, double timeout = 0.0, int line = 0, uint64_t tags = 0):
+      AutoRegister(name, source, timeout, line, tags), Fn(fn), ShouldFail(shouldFail) {}
 
   private:
-    virtual void _Run(MessageList& messages) const {
-      runFunction(Fn, Name.c_str(), ShouldFail, messages);
+    virtual void _Run(ResultSink& sink) const {
+      runFunction(Fn, *this, ShouldFail, sink);
     }
   };
 
@@ -348,7 +503,13 @@ namespace scope {
     return new FixtureType;
   }
 
-  template<class FixtureT> class FixtureTest: public TestCase {
+  // Specialize as std::true_type to have FixtureTest build a FixtureType
+  // in the test arena, instead of calling DefaultFixtureConstruct; see
+  // scope/arena.h. Fixtures with their own constructor function are never
+  // placed there.
+  template<class FixtureType> struct ArenaFixture: std::false_type {};
+
+  template<class FixtureT> class FixtureTest: public AutoRegister {
   public:
     typedef void (*FixtureTestFunction)(FixtureT&);
     typedef FixtureT* (*FixtureCtorFunction)(void);
@@ -356,24 +517,26 @@ namespace scope {
     FixtureTestFunction Fn;
     FixtureCtorFunction Ctor;
 
-    FixtureTest(const std::string& name, const std::string& source, FixtureTestFunction fn, FixtureCtorFunction ctor):
-      TestCase(name, source), Fn(fn), Ctor(ctor) {}
+    FixtureTest(const char* name, const char* source, FixtureTestFunction fn, FixtureCtorFunction ctor,
+                double timeout = 0.0, int line = 0, uint64_t tags = 0):
+      AutoRegister(name, source, timeout, line, tags), Fn(fn), Ctor(ctor) {}
 
   private:
-    virtual void _Run(MessageList& messages) const {
+    virtual void _Run(ResultSink& sink) const {
+      // an opted-in fixture goes in the thread's arena, off the heap
+      ArenaScope arenaScope(threadArena());
+      const bool inArena = ArenaFixture<FixtureT>::value && Ctor == &DefaultFixtureConstruct<FixtureT>;
       FixtureT* fixture;
       bool setup = true;
       try {
-        // std::cerr << "constructing fixture " << Name << std::endl;
-        fixture = (*Ctor)();
-        // std::cerr << "constructed fixture " << std::endl;
+        fixture = inArena ? threadArena().create<FixtureT>(): (*Ctor)();
       }
       catch (const TestFailure& fail) {
-        messages.push_back(Name + ": " + fail.what());
+        sink.testFailed(*this, Failure(fail.what()));
         setup = false;
       }
       catch (const std::exception& except) {
-        messages.push_back(Name + ": " + except.what());
+        sink.testFailed(*this, Failure(except.what()));
         setup = false;
       }
       catch (...) {
@@ -385,37 +548,33 @@ namespace scope {
         return;
       }
       try {
-        // std::cerr << "running test" << std::endl;
         (*Fn)(*fixture);
-        // std::cerr << "ran test" << std::endl;
       }
       catch (const TestFailure& fail) {
-        std::ostringstream buf;
-        buf << fail.File << ":" << fail.Line << ": " << Name << ": " << fail.what();
-        messages.push_back(buf.str());
+        sink.testFailed(*this, failureOf(fail));
       }
       catch (const std::exception& except) {
-        messages.push_back(Name + ": " + except.what());
+        sink.testFailed(*this, Failure(except.what()));
       }
       catch (...) {
         caughtBadExceptionType(Name, "test threw unknown exception type, fixture will leak");
         throw;
       }
       try {
-        // std::cerr << "deleting fixture" << std::endl;
-        delete fixture;
-        // std::cerr << "deleted fixture" << std::endl;
+        if (inArena) {
+          fixture->~FixtureT();
+        }
+        else {
+          delete fixture;
+        }
       }
       catch (const TestFailure& fail) {
-        // std::cerr << "fixture destructor threw TestFailure" << std::endl;
-        messages.push_back(Name + ": " + fail.what());
+        sink.testFailed(*this, Failure(fail.what()));
       }
       catch (const std::exception& except) {
-        // std::cerr << "fixture destructor threw std::exception" << std::endl;
-        messages.push_back(Name + ": " + except.what());
+        sink.testFailed(*this, Failure(except.what()));
       }
       catch (...) {
-        // std::cerr << "fixture destructor threw something" << std::endl;
         caughtBadExceptionType(Name, "teardown threw unknown exception type");
         throw;
       }
@@ -423,96 +582,527 @@ namespace scope {
   };
 
 
+/**************************** Suite fixtures *****************************
+
+  SCOPE_SUITE_FIXTURE(name, FixtureType) is a test taking a const
+  FixtureType&. The tests with the same fixture type in one suite (or in
+  one file, outside any SCOPE_SUITE) share a single fixture, built before
+  the first of them runs and destroyed after the last, instead of one per
+  test. If building it throws, each of those tests fails with the error,
+  and it is not built again.
+
+  The runner counts the tests about to use each fixture, and builds it
+  outside the test's timings and leak checks. With -j, it stays up until
+  every test using it is done, whichever threads they ran on, so it must
+  be safe to read from several threads at once. With -i and -p, the runner
+  builds it before forking, and the children share it copy-on-write.
+*/
+  class SharedFixtureBase {
+  public:
+    SharedFixtureBase(): Prepared(false), Users(0), Built(false) {}
+    virtual ~SharedFixtureBase() {}
+
+    // builds the fixture if it is not up, catching any setup error for the tests to report
+    void prepare() {
+      std::lock_guard<std::mutex> lock(Lock);
+      buildLocked();
+      Prepared.store(true, std::memory_order_release);
+    }
+
+    // one more test will use it
+    void retain() {
+      std::lock_guard<std::mutex> lock(Lock);
+      ++Users;
+    }
+
+    // After the last user, tears the fixture down. Returns an error if
+    // teardown threw, or an empty string.
+    std::string release() {
+      std::lock_guard<std::mutex> lock(Lock);
+      return Users && --Users == 0 ? teardownLocked(): std::string();
+    }
+
+    std::string teardown() {
+      std::lock_guard<std::mutex> lock(Lock);
+      Users = 0;
+      return teardownLocked();
+    }
+
+  protected:
+    // Whether prepare() has built the fixture, or failed to, read without
+    // the lock: a child forked by a multithreaded runner must not take it,
+    // as another thread may have held it across the fork. Neither the
+    // fixture nor the error changes until teardown.
+    bool prepared() const {
+      return Prepared.load(std::memory_order_acquire);
+    }
+
+    const std::string& setupError() const {
+      return SetupError;
+    }
+
+    // builds the fixture if need be, or throws the setup error
+    void ensureBuilt() {
+      std::lock_guard<std::mutex> lock(Lock);
+      buildLocked();
+      if (!SetupError.empty()) {
+        throw std::runtime_error(SetupError);
+      }
+    }
+
+  private:
+    virtual void build() = 0;
+    virtual void destroy() = 0;
+
+    void buildLocked() {
+      if (Built || !SetupError.empty()) {
+        return;
+      }
+      try {
+        build();
+        Built = true;
+      }
+      catch (const std::exception& except) {
+        SetupError = std::string("suite fixture setup failed: ") + except.what();
+      }
+      catch (...) {
+        SetupError = "suite fixture setup threw unknown exception type";
+      }
+    }
+
+    std::string teardownLocked() {
+      std::string error;
+      Prepared.store(false, std::memory_order_relaxed);
+      if (Built) {
+        Built = false;
+        try {
+          destroy();
+        }
+        catch (const std::exception& except) {
+          error = std::string("suite fixture teardown failed: ") + except.what();
+        }
+        catch (...) {
+          error = "suite fixture teardown threw unknown exception type";
+        }
+      }
+      SetupError.clear(); // the next run may try again
+      return error;
+    }
+
+    std::atomic<bool> Prepared;
+    std::mutex        Lock;
+    unsigned int      Users;
+    bool              Built;
+    std::string       SetupError;
+  };
+
+  template<class FixtureT> class SharedFixture: public SharedFixtureBase {
+  public:
+    typedef FixtureT* (*FixtureCtorFunction)(void);
+
+    SharedFixture(FixtureCtorFunction ctor): Ctor(ctor), Fixture(nullptr) {}
+
+    virtual ~SharedFixture() {
+      teardown();
+    }
+
+    const FixtureT& get() {
+      ensureBuilt();
+      return *Fixture;
+    }
+
+    // For a child forked after prepare(), whose changes touch only its own
+    // copy-on-write pages. Once prepared, it takes no lock.
+    FixtureT& getMutable() {
+      if (!prepared()) {
+        ensureBuilt(); // not in a child of the runner, so the lock is safe
+      }
+      else if (!Fixture) {
+        throw std::runtime_error(setupError());
+      }
+      return *Fixture;
+    }
+
+  private:
+    virtual void build() {
+      Fixture = (*Ctor)();
+    }
+
+    virtual void destroy() {
+      FixtureT* fixture = Fixture;
+      Fixture = nullptr;
+      delete fixture;
+    }
+
+    FixtureCtorFunction Ctor;
+    FixtureT*           Fixture;
+  };
+
+  // a distinct address for every type
+  template<class T> const void* typeKey() {
+    static const char key = 0;
+    return &key;
+  }
+
+  template<class FixtureT> class SuiteFixtureTest: public AutoRegister {
+  public:
+    typedef void (*SuiteFixtureTestFunction)(const FixtureT&);
+    typedef FixtureT* (*FixtureCtorFunction)(void);
+
+    SuiteFixtureTestFunction Fn;
+
+    SuiteFixtureTest(const char* name, const char* source, SuiteFixtureTestFunction fn, FixtureCtorFunction ctor,
+                     double timeout = 0.0, int line = 0, uint64_t tags = 0):
+      AutoRegister(name, source, timeout, line, tags), Fn(fn), Own(ctor), Shared(&Own) {}
+
+    virtual const void* sharedFixtureKey() const { return typeKey<FixtureT>(); }
+
+    virtual void shareFixtureWith(AutoRegister& other) {
+      Shared = static_cast<SharedFixture<FixtureT>*>(other.sharedFixture());
+    }
+
+    virtual SharedFixtureBase* sharedFixture() const { return Shared; }
+
+  private:
+    virtual void _Run(ResultSink& sink) const {
+      SharedFixture<FixtureT>* shared = Shared;
+      SuiteFixtureTestFunction fn = Fn;
+      runFunction([shared, fn]() { (*fn)(shared->get()); }, *this, false, sink);
+    }
+
+    SharedFixture<FixtureT>  Own;
+    SharedFixture<FixtureT>* Shared;
+  };
+
+/**************************** Snapshot fixtures *****************************
+
+  SCOPE_SNAPSHOT_FIXTURE(name, FixtureType) is for fixtures which are
+  expensive to build and which each test changes. The runner builds the
+  fixture once, shared like a suite fixture, and then forks a child for
+  every test (as with -i, whatever the options), so that each test gets a
+  copy-on-write image of the pristine fixture to change as it likes. The
+  cost of a test is then page faults rather than a rebuild. In a process
+  pool, the worker forks the child. Running such a test directly, with
+  Run(), changes the shared fixture itself.
+*/
+  template<class FixtureT> class SnapshotFixtureTest: public FixtureTest<FixtureT> {
+  public:
+    SnapshotFixtureTest(const char* name, const char* source, typename FixtureTest<FixtureT>::FixtureTestFunction fn,
+                        typename FixtureTest<FixtureT>::FixtureCtorFunction ctor, double timeout = 0.0, int line = 0, uint64_t tags = 0):
+      FixtureTest<FixtureT>(name, source, fn, ctor, timeout, line, tags), Own(ctor), Shared(&Own) {}
+
+    virtual bool needsOwnProcess() const { return true; }
+
+    // a suite fixture of the same type is never changed in the runner, so the two may share
+    virtual const void* sharedFixtureKey() const { return typeKey<FixtureT>(); }
+
+    virtual void shareFixtureWith(AutoRegister& other) {
+      Shared = static_cast<SharedFixture<FixtureT>*>(other.sharedFixture());
+    }
+
+    virtual SharedFixtureBase* sharedFixture() const { return Shared; }
+
+  private:
+    virtual void _Run(ResultSink& sink) const {
+      SharedFixture<FixtureT>* shared = Shared;
+      typename FixtureTest<FixtureT>::FixtureTestFunction fn = this->Fn;
+      runFunction([shared, fn]() { (*fn)(shared->getMutable()); }, *this, false, sink);
+    }
+
+    SharedFixture<FixtureT>  Own;
+    SharedFixture<FixtureT>* Shared;
+  };
+
+/**************************** Pooled fixtures *****************************
+
+  SCOPE_FIXTURE_POOLED(name, FixtureType) is for fixtures which are costly
+  to build but cheap to put back in order, like preallocated buffers or
+  thread pools. FixtureType must have a reset() method. Each thread the
+  runner uses, and so each worker of -j or -p, keeps one FixtureType,
+  built for the first pooled test of that type to run there. Every later
+  one calls reset() on it, rather than building a new fixture. If reset()
+  throws, the test fails and the fixture is rebuilt for the next one. The
+  fixture lasts until its thread exits.
+
+  What the fixture keeps, from its constructor or reset(), is not counted
+  as a leak of the test. With -i each test has a process of its own, and so
+  a fixture of its own.
+*/
+  template<class FixtureT> class PooledFixtureTest: public FixtureTest<FixtureT> {
+  public:
+    PooledFixtureTest(const char* name, const char* source, typename FixtureTest<FixtureT>::FixtureTestFunction fn,
+                      typename FixtureTest<FixtureT>::FixtureCtorFunction ctor, double timeout = 0.0, int line = 0, uint64_t tags = 0):
+      FixtureTest<FixtureT>(name, source, fn, ctor, timeout, line, tags) {}
+
+  private:
+    static std::unique_ptr<FixtureT>& threadFixture() {
+      static thread_local std::unique_ptr<FixtureT> pooled;
+      return pooled;
+    }
+
+    virtual void _Run(ResultSink& sink) const {
+      std::unique_ptr<FixtureT>& pooled(threadFixture());
+      try {
+        LeakScope kept; // the fixture outlives the test
+        if (pooled) {
+          pooled->reset();
+        }
+        else {
+          pooled.reset((*this->Ctor)());
+        }
+      }
+      catch (const TestFailure& fail) {
+        sink.testFailed(*this, Failure(fail.what()));
+        pooled.reset();
+        return;
+      }
+      catch (const std::exception& except) {
+        sink.testFailed(*this, Failure(except.what()));
+        pooled.reset();
+        return;
+      }
+      catch (...) {
+        caughtBadExceptionType(this->Name, "setup threw unknown exception type");
+        pooled.reset();
+        throw;
+      }
+      FixtureT* fixture = pooled.get();
+      typename FixtureTest<FixtureT>::FixtureTestFunction fn = this->Fn;
+      runFunction([fixture, fn]() { (*fn)(*fixture); }, *this, false, sink);
+    }
+  };
+
+/**************************** Parameterized tests *****************************
+
+  SCOPE_TEST_PARAM(name, generator) runs its body once for each element of
+  the sequence the generator expression yields, as param:
+
+    SCOPE_TEST_PARAM(parsesRow, loadRows("rows.csv")) {
+      SCOPE_ASSERT(parse(param).Valid);
+    }
+
+  When the runner starts, it evaluates the generator once and registers
+  each element as a test of its own, name[0], name[1], and so on. Each is
+  reported, filtered, selected, sharded and scheduled separately, so with
+  -j or -p a long table spreads over every worker. The generator runs after
+  main() begins, and may allocate. If it throws, name stays a single test,
+  which fails with the error. Running name directly, with Run(), goes
+  through the elements in turn, and stops at the first failure.
+*/
+  template<class ParamT> class ParamCase: public AutoRegister {
+  public:
+    typedef void (*ParamTestFunction)(const ParamT&);
+
+    ParamCase(const std::string& name, const AutoRegister& from, ParamTestFunction fn, const ParamT& param):
+      AutoRegister("", from.SourceFile, from.Timeout, from.Line, from.Tags), Fn(fn), Param(param), CaseName(name)
+    {
+      Name = CaseName.c_str();
+    }
+
+    ParamCase(const ParamCase&) = delete;
+    ParamCase& operator=(const ParamCase&) = delete;
+
+  private:
+    virtual void _Run(ResultSink& sink) const {
+      ParamTestFunction fn = Fn;
+      const ParamT* param = &Param;
+      runFunction([fn, param]() { (*fn)(*param); }, *this, false, sink);
+    }
+
+    ParamTestFunction Fn;
+    ParamT            Param;
+    std::string       CaseName; // the test's Name
+  };
+
+  template<class SequenceT> class ParamTest: public AutoRegister {
+  public:
+    typedef typename std::decay<decltype(*std::begin(std::declval<SequenceT&>()))>::type ParamType;
+    typedef SequenceT (*GeneratorFunction)(void);
+    typedef typename ParamCase<ParamType>::ParamTestFunction ParamTestFunction;
+
+    ParamTest(const char* name, const char* source, GeneratorFunction gen, ParamTestFunction fn, double timeout = 0.0, int line = 0, uint64_t tags = 0):
+      AutoRegister(name, source, timeout, line, tags), Gen(gen), Fn(fn) {}
+
+    virtual bool expand(std::vector<std::unique_ptr<AutoRegister>>& cases) const {
+      const std::size_t before = cases.size();
+      try {
+        auto&& params((*Gen)());
+        std::size_t i = 0;
+        for (const auto& param: params) {
+          cases.emplace_back(new ParamCase<ParamType>(std::string(Name) + '[' + std::to_string(i++) + ']', *this, Fn, param));
+        }
+      }
+      catch (...) {
+        // left whole, so that running it reports the error
+        cases.resize(before);
+        return false;
+      }
+      return true;
+    }
+
+  private:
+    virtual void _Run(ResultSink& sink) const {
+      GeneratorFunction gen = Gen;
+      ParamTestFunction fn = Fn;
+      runFunction([gen, fn]() {
+        auto&& params((*gen)());
+        for (const auto& param: params) {
+          (*fn)(param);
+        }
+      }, *this, false, sink);
+    }
+
+    GeneratorFunction Gen;
+    ParamTestFunction Fn;
+  };
+
+
 /**************************** TestRunner decl *****************************/
-  template<class T> class Node;
-  class AutoRegister;
+  class AutoRegisterSuite;
 
   class TestRunner {
   public:
     static Node<AutoRegister>& root();
+    static Node<AutoRegisterSuite>& suites();
     static std::string& lastTest();
 
     virtual ~TestRunner() {}
 
-    virtual void runTest(const TestCase& test, MessageList& messages) = 0;
-    virtual void run(MessageList& messages) = 0;
+    virtual void runTest(const TestCase& test, ResultSink& sink) = 0;
+    virtual void run(ResultSink& sink) = 0;
 
     virtual unsigned int numTests() const = 0;
     virtual unsigned int numRun() const = 0;
     virtual void setDebug(bool) = 0;
-    virtual void setFilter(const std::shared_ptr<std::regex>& filter) = 0;
   };
 
 
 /**************************** Auto-registration types *****************************/
-  template<class T> class Node {
+  class Test: public BoundTest {
   public:
-    Node(): Next(nullptr), FirstChild(nullptr) {}
-
-    void insert(T& node) {
-      node.Next = FirstChild;
-      FirstChild = &node;
+    Test(const char* name, const char* source, const TestFunction& fn, bool shouldFail = false, double timeout = 0.0, int line = 0, uint64_t tags = 0):
+      BoundTest(name, source, fn, shouldFail, timeout, line, tags)
+    {
+      TestRunner::root().insert(*this);
     }
 
-    T*  Next;
-    T*  FirstChild;
+    virtual ~Test() {}
   };
 
-  class AutoRegister: public Node<AutoRegister> {
+  // TestT is FixtureTest or a class extending it, e.g. SnapshotFixtureTest
+  template<class FixtureT, class TestT = FixtureTest<FixtureT>> class AutoRegisterFixture: public TestT {
   public:
-    const char*     TestName;
-    const char*     SourceFile;
-
-    AutoRegister(const char* name, const char* source): TestName(name), SourceFile(source) {}
-
-    virtual ~AutoRegister() {}
+    AutoRegisterFixture(const char* name, const char* source, typename FixtureTest<FixtureT>::FixtureTestFunction fn,
+                        typename FixtureTest<FixtureT>::FixtureCtorFunction ctor, double timeout = 0.0, int line = 0, uint64_t tags = 0):
+      TestT(name, source, fn, ctor, timeout, line, tags)
+    {
+      TestRunner::root().insert(*this);
+    }
 
-    virtual TestCase* Construct() { return nullptr; };
+    virtual ~AutoRegisterFixture() {}
   };
 
-  class AutoRegisterTest: public AutoRegister {
+  template<class FixtureT> class AutoRegisterSuiteFixture: public SuiteFixtureTest<FixtureT> {
   public:
-    AutoRegisterTest(const char* name, const char* source):
-      AutoRegister(name, source)
+    AutoRegisterSuiteFixture(const char* name, const char* source, typename SuiteFixtureTest<FixtureT>::SuiteFixtureTestFunction fn,
+                             typename SuiteFixtureTest<FixtureT>::FixtureCtorFunction ctor, double timeout = 0.0, int line = 0, uint64_t tags = 0):
+      SuiteFixtureTest<FixtureT>(name, source, fn, ctor, timeout, line, tags)
     {
       TestRunner::root().insert(*this);
     }
   };
 
-  class Test: public AutoRegisterTest {
+  template<class SequenceT> class AutoRegisterParam: public ParamTest<SequenceT> {
   public:
-    TestFunction  Fn;
-    bool          ShouldFail;
-
-    Test(const char* name, const char* source, TestFunction fn, bool shouldFail = false):
-      AutoRegisterTest(name, source), Fn(fn), ShouldFail(shouldFail) {}
+    AutoRegisterParam(const char* name, const char* source, typename ParamTest<SequenceT>::GeneratorFunction gen,
+                      typename ParamTest<SequenceT>::ParamTestFunction fn, double timeout = 0.0, int line = 0, uint64_t tags = 0):
+      ParamTest<SequenceT>(name, source, gen, fn, timeout, line, tags)
+    {
+      TestRunner::root().insert(*this);
+    }
+  };
 
-    virtual ~Test() {}
+  // SCOPE_SUITE(name): the tests after it in its source file, up to the next one, form a suite
+  class AutoRegisterSuite: public Node<AutoRegisterSuite> {
+  public:
+    const char* Name;
+    const char* SourceFile;
+    int         Line;
 
-    virtual TestCase* Construct() {
-      return new BoundTest(TestName, SourceFile, Fn, ShouldFail);
+    AutoRegisterSuite(const char* name, const char* source, int line):
+      Name(name), SourceFile(source), Line(line)
+    {
+      TestRunner::suites().insert(*this);
     }
   };
 
-  template<class FixtureT> class AutoRegisterFixture: public AutoRegisterTest {
+/**************************** Section registration *****************************
+
+  Every SCOPE_TEST normally constructs a static Test object and links it
+  into TestRunner::root() during static initialization. With tens of
+  thousands of tests, that work shows up in the startup time of the binary.
+
+  Defining SCOPE_SECTION_REGISTRATION before including scope/test.h (or on
+  the command line, for the whole binary) makes SCOPE_TEST, SCOPE_TEST_FAILS
+  and SCOPE_TEST_TIMEOUT emit a constant TestDescriptor into the
+  "scope_tests" section instead. The linker gathers the descriptors of all
+  translation units into one array, bounded by __start_scope_tests and
+  __stop_scope_tests, so there is no code to run at static-init time at all.
+  The runner scans the array when it starts and wraps each descriptor in a
+  SectionTest adapter, so the rest of the runner cannot tell the difference.
+
+  This needs an ELF target (Linux, the BSDs) and GCC or Clang. Elsewhere the
+  macro is ignored, and tests register as usual. Fixture tests always
+  register as usual. Sanitizers which pad globals with redzones break the
+  array layout, so leave it off in ASan builds. Each descriptor is given its
+  natural alignment explicitly, since the compiler otherwise pads large
+  globals out to 32 bytes and the section would no longer be an array.
+*/
+  struct TestDescriptor {
+    enum Flags {
+      ShouldFail = 1
+    };
+
+    const char*  Name;
+    const char*  SourceFile;
+    int          Line;
+    void       (*Fn)(void);
+    unsigned int Flag;
+    double       Timeout;
+    const char*  Tags;
+  };
+
+  // not linked into root(); the runner keeps its own list of these
+  class SectionTest: public BoundTest {
   public:
-    typedef void (*FixtureTestFunction)(FixtureT&);
-    typedef FixtureT* (*FixtureCtorFunction)(void);
+    SectionTest(const TestDescriptor& desc):
+      BoundTest(desc.Name, desc.SourceFile, desc.Fn, (desc.Flag & TestDescriptor::ShouldFail) != 0, desc.Timeout, desc.Line,
+                internTags(desc.Tags)) {}
+  };
 
-    FixtureTestFunction Fn;
-    FixtureCtorFunction Ctor;
+  namespace user_defined {}
+}
 
-    AutoRegisterFixture(const char* name, const char* source, FixtureTestFunction fn, FixtureCtorFunction ctor):
-      AutoRegisterTest(name, source), Fn(fn), Ctor(ctor) {}
+#if defined(__ELF__) && defined(__GNUC__)
+#define SCOPE_HAS_SECTION_REGISTRATION 1
 
-    virtual ~AutoRegisterFixture() {}
+// defined by the linker when any object file has a scope_tests section; weak, so they are null when none does
+extern "C" {
+  extern const scope::TestDescriptor __start_scope_tests[] __attribute__((weak));
+  extern const scope::TestDescriptor __stop_scope_tests[] __attribute__((weak));
+}
+#endif
 
-    virtual TestCase* Construct() {
-      return new FixtureTest<FixtureT>(TestName, SourceFile, Fn, Ctor);
+namespace scope {
+  // the descriptors registered with SCOPE_SECTION_REGISTRATION, in link order
+  inline std::pair<const TestDescriptor*, const TestDescriptor*> sectionTests() {
+#if defined(SCOPE_HAS_SECTION_REGISTRATION)
+    if (__start_scope_tests && __stop_scope_tests) {
+      return std::make_pair(__start_scope_tests, __stop_scope_tests);
     }
-  };
-
-  namespace user_defined {}
+#endif
+    return std::make_pair(nullptr, nullptr);
+  }
 }
 
 
@@ -529,10 +1119,24 @@ namespace scope {
 // if "void testname(void) {}" results in a multiple-symbol linker error, then so will the namespacing.
 
 
-#define SCOPE_TEST_AUTO_REGISTRATION(testname, shouldFail) \
+#if defined(SCOPE_SECTION_REGISTRATION) && defined(SCOPE_HAS_SECTION_REGISTRATION)
+#define SCOPE_TEST_AUTO_REGISTRATION_TAGGED(testname, shouldFail, seconds, tags) \
   namespace scope { namespace user_defined { namespace { namespace SCOPE_CAT(testname, ns) { \
-    Test reg(#testname, __FILE__, testname, shouldFail); \
+    __attribute__((used, section("scope_tests"), aligned(alignof(TestDescriptor)))) \
+    const TestDescriptor reg = {#testname, __FILE__, __LINE__, testname, (shouldFail) ? unsigned(TestDescriptor::ShouldFail): 0u, seconds, tags}; \
   } } } }
+#else
+#define SCOPE_TEST_AUTO_REGISTRATION_TAGGED(testname, shouldFail, seconds, tags) \
+  namespace scope { namespace user_defined { namespace { namespace SCOPE_CAT(testname, ns) { \
+    Test reg(#testname, __FILE__, testname, shouldFail, seconds, __LINE__, internTags(tags)); \
+  } } } }
+#endif
+
+#define SCOPE_TEST_AUTO_REGISTRATION_TIMEOUT(testname, shouldFail, seconds) \
+  SCOPE_TEST_AUTO_REGISTRATION_TAGGED(testname, shouldFail, seconds, "")
+
+#define SCOPE_TEST_AUTO_REGISTRATION(testname, shouldFail) \
+  SCOPE_TEST_AUTO_REGISTRATION_TIMEOUT(testname, shouldFail, 0.0)
 
 #define SCOPE_TEST(testname) \
   void testname(void);      \
@@ -544,20 +1148,97 @@ namespace scope {
   SCOPE_TEST_AUTO_REGISTRATION(testname, true) \
   void testname(void)
 
+// overrides --timeout for this test
+#define SCOPE_TEST_TIMEOUT(testname, seconds) \
+  void testname(void);            \
+  SCOPE_TEST_AUTO_REGISTRATION_TIMEOUT(testname, false, seconds) \
+  void testname(void)
+
+// tags is a string literal, e.g. "slow, io"; see scope/tags.h
+#define SCOPE_TEST_TAGS(testname, tags) \
+  void testname(void);            \
+  SCOPE_TEST_AUTO_REGISTRATION_TAGGED(testname, false, 0.0, tags) \
+  void testname(void)
+
+// one test per element of the sequence the generator yields, as param; the
+// generator may contain commas, e.g. std::vector<int>{1, 2, 3}
+#define SCOPE_TEST_PARAM(testname, ...) \
+  namespace scope { namespace user_defined { namespace { namespace SCOPE_CAT(testname, ns) { \
+    auto params() -> decltype(__VA_ARGS__) { return __VA_ARGS__; } \
+    typedef ParamTest<decltype(params())>::ParamType ParamType; \
+  } } } } \
+  void testname(const scope::user_defined::SCOPE_CAT(testname, ns)::ParamType& param); \
+  namespace scope { namespace user_defined { namespace { namespace SCOPE_CAT(testname, ns) { \
+    AutoRegisterParam<decltype(params())> reg(#testname, __FILE__, params, testname, 0.0, __LINE__); \
+  } } } } \
+  void testname(const scope::user_defined::SCOPE_CAT(testname, ns)::ParamType& param)
+
 // no need for auto-register if the test is i
 #define SCOPE_TEST_IGNORE(testname) \
   void testname(void)
 
-#define SCOPE_FIXTURE_AUTO_REGISTRATION(fixtureType, testfunction, ctorfunction) \
+// Starts a suite: the tests below it in this file, up to the next SCOPE_SUITE,
+// can be selected, listed and set up together. Use it at global scope.
+#define SCOPE_SUITE(suitename) \
+  namespace scope { namespace user_defined { namespace { namespace SCOPE_CAT(suitename, suite) { \
+    AutoRegisterSuite reg(#suitename, __FILE__, __LINE__); \
+  } } } }
+
+#define SCOPE_FIXTURE_AUTO_REGISTRATION_TAGGED(fixtureType, testfunction, ctorfunction, seconds, tags) \
   namespace scope { namespace user_defined { namespace { namespace SCOPE_CAT(testfunction, ns) { \
-    AutoRegisterFixture<fixtureType> reg(#testfunction, __FILE__, testfunction, ctorfunction); \
+    AutoRegisterFixture<fixtureType> reg(#testfunction, __FILE__, testfunction, ctorfunction, seconds, __LINE__, internTags(tags)); \
   } } } }
 
+#define SCOPE_FIXTURE_AUTO_REGISTRATION_TIMEOUT(fixtureType, testfunction, ctorfunction, seconds) \
+  SCOPE_FIXTURE_AUTO_REGISTRATION_TAGGED(fixtureType, testfunction, ctorfunction, seconds, "")
+
+#define SCOPE_FIXTURE_AUTO_REGISTRATION(fixtureType, testfunction, ctorfunction) \
+  SCOPE_FIXTURE_AUTO_REGISTRATION_TIMEOUT(fixtureType, testfunction, ctorfunction, 0.0)
+
 #define SCOPE_FIXTURE(testname, fixtureType) \
   void testname(fixtureType& fixture); \
   SCOPE_FIXTURE_AUTO_REGISTRATION(fixtureType, testname, &DefaultFixtureConstruct<fixtureType>) \
   void testname(fixtureType& fixture)
 
+// overrides --timeout for this test
+#define SCOPE_FIXTURE_TIMEOUT(testname, fixtureType, seconds) \
+  void testname(fixtureType& fixture); \
+  SCOPE_FIXTURE_AUTO_REGISTRATION_TIMEOUT(fixtureType, testname, &DefaultFixtureConstruct<fixtureType>, seconds) \
+  void testname(fixtureType& fixture)
+
+#define SCOPE_FIXTURE_TAGS(testname, fixtureType, tags) \
+  void testname(fixtureType& fixture); \
+  SCOPE_FIXTURE_AUTO_REGISTRATION_TAGGED(fixtureType, testname, &DefaultFixtureConstruct<fixtureType>, 0.0, tags) \
+  void testname(fixtureType& fixture)
+
+// one const fixture, built once and shared by the tests of its type in the suite
+#define SCOPE_SUITE_FIXTURE(testname, fixtureType) \
+  void testname(const fixtureType& fixture); \
+  namespace scope { namespace user_defined { namespace { namespace SCOPE_CAT(testname, ns) { \
+    AutoRegisterSuiteFixture<fixtureType> reg(#testname, __FILE__, testname, &DefaultFixtureConstruct<fixtureType>, 0.0, __LINE__); \
+  } } } } \
+  void testname(const fixtureType& fixture)
+
+// one fixture, built once, of which each test gets its own copy-on-write image in a child process
+#define SCOPE_SNAPSHOT_FIXTURE(testname, fixtureType) \
+  SCOPE_SNAPSHOT_FIXTURE_TIMEOUT(testname, fixtureType, 0.0)
+
+// overrides --timeout for this test
+#define SCOPE_SNAPSHOT_FIXTURE_TIMEOUT(testname, fixtureType, seconds) \
+  void testname(fixtureType& fixture); \
+  namespace scope { namespace user_defined { namespace { namespace SCOPE_CAT(testname, ns) { \
+    AutoRegisterFixture<fixtureType, SnapshotFixtureTest<fixtureType>> reg(#testname, __FILE__, testname, &DefaultFixtureConstruct<fixtureType>, seconds, __LINE__); \
+  } } } } \
+  void testname(fixtureType& fixture)
+
+// one fixture per runner thread, reused by the tests on it after a call to fixture.reset()
+#define SCOPE_FIXTURE_POOLED(testname, fixtureType) \
+  void testname(fixtureType& fixture); \
+  namespace scope { namespace user_defined { namespace { namespace SCOPE_CAT(testname, ns) { \
+    AutoRegisterFixture<fixtureType, PooledFixtureTest<fixtureType>> reg(#testname, __FILE__, testname, &DefaultFixtureConstruct<fixtureType>, 0.0, __LINE__); \
+  } } } } \
+  void testname(fixtureType& fixture)
+
 #define SCOPE_FIXTURE_CTOR(testname, fixtureType, ctorExpr) \
   void testname(fixtureType& fixture); \
   namespace scope { namespace user_defined { namespace { namespace SCOPE_CAT(testname, ns) { \
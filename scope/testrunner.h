@@ -5,43 +5,58 @@
 
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cassert>
+#include <cmath>
 #include <csignal>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
 #include <memory>
 #include <map>
-#include <regex>
+#include <set>
 #include <thread>
 #include <mutex>
+#include <vector>
 
 #include "tclap/CmdLine.h"
 
 
 #include "test.h"
+#include "benchmark.h"
+#include "baseline.h"
+#include "filter.h"
+#include "history.h"
+#include "isolate.h"
+#include "perfcounters.h"
+#include "reporters.h"
+#include "resources.h"
+#include "shard.h"
+#include "tree.h"
+#include "watchdog.h"
 
 namespace scope {
 
-  void runFunction(scope::TestFunction test, const char* testname, bool shouldFail, MessageList& messages) {
+  void runFunction(const scope::TestFunction& test, const TestCommon& info, bool shouldFail, ResultSink& sink) {
     try {
       test();
       if (shouldFail) {
-        std::string msg(testname);
-        msg.append(": marked for failure but did not throw scope::TestFailure.");
-        messages.push_back(msg);
+        sink.testFailed(info, Failure("marked for failure but did not throw scope::TestFailure."));
       }
     }
     catch (const TestFailure& fail) {
       if (!shouldFail) {
-        std::ostringstream buf;
-        buf << fail.File << ":" << fail.Line << ": " << testname << ": " << fail.what();
-        messages.push_back(buf.str());
+        sink.testFailed(info, failureOf(fail));
       }
     }
     catch (const std::exception& except) {
-      messages.push_back(std::string(testname) + ": " + except.what());
+      sink.testFailed(info, Failure(except.what()));
     }
     catch (...) {
-      caughtBadExceptionType(testname, "test threw unrecognized type");
+      caughtBadExceptionType(info.Name, "test threw unrecognized type");
       throw;
     }
   }
@@ -50,6 +65,12 @@ namespace scope {
     std::cerr << name << ": " << msg << "; please at least inherit from std::exception" << std::endl;
   }
 
+  struct TestMeasurement {
+    std::string Name,
+                SourceFile;
+    MetricList  Metrics;
+  };
+
   namespace {
     template<class X>
     bool always_true(const X&) {
@@ -59,36 +80,95 @@ namespace scope {
     class TestRunnerImpl: public TestRunner {
     public:
       TestRunnerImpl():
-        NumTests(0), NumRun(0), Debug(false)
+        FilterValid(false), NumTests(0), NumRun(0), Jobs(1), Debug(false), Isolate(false), Pool(false), AllocReport(false), Leaks(false), ResourceReport(false),
+        ShardIndex(0), TotalShards(1), ShardPlanned(false), Timeout(0.0)
       {
+        const auto descs(sectionTests());
+        for (const TestDescriptor* d = descs.first; d != descs.second; ++d) {
+          SectionTests.emplace_back(new SectionTest(*d));
+        }
+        for (auto cur(suites().FirstChild); cur; cur = cur->Next) {
+          Tree.addSuite(cur->SourceFile, cur->Name, cur->Line);
+        }
+        for (auto cur(root().FirstChild); cur; cur = cur->Next) {
+          if (!cur->expand(ParamCases)) {
+            Tree.addTest(cur);
+          }
+        }
+        for (auto& cur: SectionTests) {
+          Tree.addTest(cur.get());
+        }
+        for (auto& cur: ParamCases) {
+          Tree.addTest(cur.get());
+        }
+        Tree.finish();
+        shareSuiteFixtures();
         traverse([this](AutoRegister*) {
           ++this->NumTests;
         });
       }
 
-      virtual void runTest(const TestCase& test, MessageList& messages) {
-        if (!(NameFilter || SourceFilter)
-          || (NameFilter && std::regex_match(test.Name, *NameFilter))
-          || (SourceFilter && std::regex_match(test.SourceFile, *SourceFilter)))
-        {
-          lastTest() = test.Name;
-          if (Debug) {
-            std::cerr << "Running " << test.Name << std::endl;
-          }
-          ++NumRun;
-          test.Run(messages);
-          if (Debug) {
-            std::cerr << "Done with " << test.Name << std::endl;
+      virtual void runTest(const TestCase& test, ResultSink& sink) {
+        if (selected(test)) {
+          // the shared fixture, if any, is prepared but not retained, and so stays up
+          const AutoRegister* reg = dynamic_cast<const AutoRegister*>(&test);
+          execute(test, sink, reg ? reg->sharedFixture(): nullptr);
+        }
+      }
+
+      virtual void run(ResultSink& sink) {
+        std::vector<AutoRegister*> tests(chosen(false));
+        if (Pool) {
+          runPool(tests, sink);
+          return;
+        }
+        for (AutoRegister* test: tests) {
+          if (SharedFixtureBase* shared = test->sharedFixture()) {
+            shared->retain();
           }
-          lastTest().clear();
+        }
+        if (Jobs > 1) {
+          runParallel(tests, sink);
+          return;
+        }
+        for (AutoRegister* test: tests) {
+          execute(*test, sink, test->sharedFixture());
         }
       }
 
-      virtual void run(MessageList& messages) {
-        traverse([this, &messages](AutoRegister* cur) { 
-          std::unique_ptr<TestCase> test(cur->Construct());
-          this->runTest(*test, messages);        
-        });
+      // benchmarks always run serially and in-process, since anything
+      // running alongside them would skew the timings
+      virtual void runBenchmarks(const BenchmarkOptions& opts, std::vector<BenchmarkResult>& results, ResultSink& sink) {
+        for (AutoRegister* cur: chosen(true)) {
+          const BenchmarkCase* test = static_cast<const BenchmarkCase*>(cur);
+          ++this->NumRun;
+          lastTest() = test->Name;
+          if (this->Debug) {
+            std::cerr << "Benchmarking " << test->Name << std::endl;
+          }
+          BenchmarkResult result;
+          TestResult perOp;
+          PerfCounters* counters = this->threadCounters();
+          if (counters) {
+            counters->start();
+          }
+          const auto start = std::chrono::steady_clock::now();
+          const bool ok = test->measure(opts, result, perOp);
+          perOp.Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+          if (counters) {
+            this->readCounters(*counters, perOp.Metrics, static_cast<double>(std::max<uint64_t>(1, result.TotalIterations)));
+          }
+          MetricList stats;
+          if (ok) {
+            results.push_back(result);
+            stats = benchmarkMetrics(result);
+          }
+          else {
+            perOp.Metrics.clear();
+          }
+          this->finish(*test, perOp, sink, stats);
+          lastTest().clear();
+        }
       }
 
       virtual unsigned int numTests() const {
@@ -103,29 +183,557 @@ namespace scope {
         Debug = val;
       }
 
-      virtual void setFilter(const std::shared_ptr<std::regex>& filter) {
-        NameFilter = filter;
+      void setFilter(const GlobSet& include, const GlobSet& exclude) {
+        NameIncludes = include;
+        NameExcludes = exclude;
+        FilterValid = false;
+      }
+
+      void setSourceFilter(const GlobSet& include, const GlobSet& exclude) {
+        SourceIncludes = include;
+        SourceExcludes = exclude;
+        FilterValid = false;
+      }
+
+      void setTags(const TagExpression& expr) {
+        TagFilter = expr;
+        FilterValid = false;
+      }
+
+      // adds a file[::suite[::test]] to run; false if there is no such thing
+      bool select(const std::string& path) {
+        TestTree::Path found;
+        if (!Tree.find(path, found)) {
+          return false;
+        }
+        Selections.push_back(found);
+        FilterValid = false;
+        return true;
+      }
+
+      virtual void setIsolate(bool val) {
+        Isolate = val;
+      }
+
+      // pool mode isolates tests in Jobs long-lived worker processes
+      virtual void setPool(bool val) {
+        Pool = val;
       }
 
-      virtual void setSourceFilter(const std::shared_ptr<std::regex>& sourceFilter) {
-        SourceFilter = sourceFilter;
+      // 0 means one worker per hardware thread
+      virtual void setJobs(unsigned int jobs) {
+        Jobs = jobs ? jobs: std::max(1u, std::thread::hardware_concurrency());
       }
 
+      // hardware counters to read around each test; empty disables them
+      virtual void setCounters(const std::vector<std::string>& names) {
+        CounterNames = names;
+      }
+
+      // needs scope/alloccount.h to be linked in
+      virtual void setAllocReport(bool val) {
+        AllocReport = val && allocationCountingInstalled();
+      }
+
+      // needs scope/alloccount.h to be linked in
+      virtual void setLeakCheck(bool val) {
+        Leaks = val && allocationCountingInstalled();
+      }
+
+      // CPU time, page faults and context switches of each test
+      virtual void setResourceReport(bool val) {
+        ResourceReport = val;
+      }
+
+      // records durations, and dispatches parallel and pooled tests longest-first
+      virtual void setHistory(const std::shared_ptr<DurationHistory>& history) {
+        History = history;
+      }
+
+      // Bin-packs shards by these durations, instead of hashing. It is only
+      // read, unlike the --history file, so every shard given the same one
+      // makes the same plan.
+      virtual void setShardHistory(const std::shared_ptr<const DurationHistory>& history) {
+        ShardHistory = history;
+      }
+
+      // only run the index-th of total shards of the selected tests
+      virtual void setShard(unsigned int index, unsigned int total) {
+        ShardIndex = index;
+        TotalShards = std::max(1u, total);
+      }
+
+      // seconds; 0 for none. Tests may override it at registration.
+      virtual void setTimeout(double seconds) {
+        Timeout = seconds;
+      }
+
+      const MessageList& warnings() const {
+        return Warnings;
+      }
+
+      // metrics of every test which reported any, in completion order
+      const std::vector<TestMeasurement>& measurements() const {
+        return Measurements;
+      }
+
+      // every registered test, in tree order
       template<class AutoRegFnType>
       void traverse(AutoRegFnType&& fn) {
-        auto& r(root());
-        for (auto cur(r.FirstChild); cur; cur = cur->Next) {
-          fn(cur);
+        for (const TestTree::FileNode& file: Tree.files()) {
+          for (const TestTree::SuiteNode& suite: file.Suites) {
+            for (AutoRegister* test: suite.Tests) {
+              fn(test);
+            }
+          }
         }
       }
 
+      // the tests and benchmarks which pass the filters, as an indented tree
+      void list(std::ostream& out) {
+        const TestTree::FileNode* lastFile = nullptr;
+        const TestTree::SuiteNode* lastSuite = nullptr;
+        visitFiltered([&](const TestTree::FileNode& file, const TestTree::SuiteNode& suite, AutoRegister* test) {
+          if (&file != lastFile) {
+            out << file.SourceFile << '\n';
+            lastFile = &file;
+          }
+          if (&suite != lastSuite && !suite.Name.empty()) {
+            out << "  " << suite.Name << '\n';
+          }
+          lastSuite = &suite;
+          out << (suite.Name.empty() ? "  ": "    ") << test->Name;
+          if (test->Tags) {
+            out << " [" << tagNames(test->Tags) << ']';
+          }
+          out << '\n';
+        });
+      }
+
     private:
-      std::shared_ptr<std::regex> NameFilter,
-                                  SourceFilter;
+      void runInProcess(const TestCase& test, TestResult& result) {
+        lastTest() = test.Name;
+        if (Debug) {
+          debugLine("Running ", test.Name);
+        }
+        // in isolated and pool mode, and for a test which needs its own
+        // process, this is a forked child and the parent watches it
+        const double limit = Isolate || Pool || test.needsOwnProcess() ? 0.0: timeoutFor(test, Timeout);
+        const unsigned int alarm = limit > 0.0 ? TheWatchdog.arm(test.Name, limit, 0): 0;
+        const ResourceUsage usageBefore(ResourceReport ? threadResourceUsage(): ResourceUsage());
+        PerfCounters* counters = threadCounters();
+        if (counters) {
+          counters->start();
+        }
+        // the runner's own bookkeeping stays out of the test's allocations
+        Arena& arena(threadArena());
+        ArenaScope perTest(arena);
+        const AllocationCounts allocsBefore(threadAllocations());
+        std::unique_ptr<LeakScope, ArenaDestroy<LeakScope>> leakScope(Leaks ? arena.create<LeakScope>(): nullptr);
+        const auto start = std::chrono::steady_clock::now();
+        test.Run(result);
+        result.Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (limit > 0.0) {
+          TheWatchdog.disarm(alarm);
+        }
+        const LeakReport leaks(leakScope ? leakScope->finish(): LeakReport());
+        const AllocationCounts allocs(threadAllocations() - allocsBefore);
+        if (counters) {
+          readCounters(*counters, result.Metrics, 1.0);
+        }
+        if (ResourceReport) {
+          const ResourceUsage usage(threadResourceUsage() - usageBefore);
+          result.Metrics.emplace_back("user-ms", usage.UserMs);
+          result.Metrics.emplace_back("sys-ms", usage.SysMs);
+          result.Metrics.emplace_back("minor-faults", static_cast<double>(usage.MinorFaults));
+          result.Metrics.emplace_back("major-faults", static_cast<double>(usage.MajorFaults));
+          result.Metrics.emplace_back("vol-switches", static_cast<double>(usage.VoluntarySwitches));
+          result.Metrics.emplace_back("invol-switches", static_cast<double>(usage.InvoluntarySwitches));
+          result.Metrics.emplace_back("max-rss-kb", static_cast<double>(usage.MaxRssKb));
+        }
+        if (AllocReport) {
+          result.Metrics.emplace_back("allocs", static_cast<double>(allocs.Allocations));
+          result.Metrics.emplace_back("alloc-bytes", static_cast<double>(allocs.BytesAllocated));
+        }
+        // a failing test's failures are still live, so only passing tests are checked
+        if (leaks.Count && result.passed()) {
+          result.Metrics.emplace_back("leaked-allocs", static_cast<double>(leaks.Count));
+          result.Metrics.emplace_back("leaked-bytes", static_cast<double>(leaks.Bytes));
+          result.Warnings.push_back(describeLeak(test.Name, leaks));
+        }
+        if (Debug) {
+          debugLine("Done with ", test.Name);
+        }
+        lastTest().clear();
+      }
+
+      // One write(2), so that lines from other threads cannot split it. It
+      // takes no lock, not even stderr's, as this may be a child forked
+      // while another thread held one.
+      static void debugLine(const char* what, const char* name) {
+        std::string line(what);
+        line += name;
+        line += '\n';
+        writeAll(2, line.data(), line.size());
+      }
+
+      InProcessRunner inProcessRunner() {
+        return [this](const TestCase& test, TestResult& result) {
+          this->runInProcess(test, result);
+        };
+      }
+
+      // A test's events reach the sink together, so that tests on other
+      // threads cannot interleave with them. Benchmarks report their
+      // statistics along with their metrics, but not in the measurements.
+      void finish(const TestCase& test, TestResult& result, ResultSink& sink, const MetricList& stats = MetricList()) {
+        std::lock_guard<std::mutex> lock(ResultsLock);
+        sink.testStarted(test);
+        for (const Failure& f: result.Failures) {
+          sink.testFailed(test, f);
+        }
+        if (!result.Metrics.empty() || !stats.empty()) {
+          MetricList all(stats);
+          all.insert(all.end(), result.Metrics.begin(), result.Metrics.end());
+          sink.testMetrics(test, all);
+        }
+        sink.testFinished(test, result.Seconds, result.passed());
+        if (!result.Metrics.empty()) {
+          Measurements.push_back(TestMeasurement{test.Name, test.SourceFile, std::move(result.Metrics)});
+        }
+        Warnings.splice(Warnings.end(), result.Warnings);
+        if (History && result.Seconds > 0.0) {
+          History->record(test.SourceFile, test.Name, result.Seconds);
+        }
+      }
+
+      static std::string describeLeak(const std::string& name, const LeakReport& leaks) {
+        std::ostringstream buf;
+        buf << name << ": suspected leak of " << leaks.Bytes << " bytes in " << leaks.Count << " allocations (sizes:";
+        for (std::size_t size: leaks.Sizes) {
+          buf << ' ' << size;
+        }
+        if (leaks.Count > leaks.Sizes.size()) {
+          buf << " and " << leaks.Count - leaks.Sizes.size() << " more";
+        }
+        buf << ')';
+        return buf.str();
+      }
+
+      // Counter groups count the thread that opened them, so each worker
+      // thread opens its own, and so does each forked child, since a group
+      // inherited across fork() still counts the parent.
+      PerfCounters* threadCounters() {
+        if (CounterNames.empty()) {
+          return nullptr;
+        }
+        static thread_local pid_t owner = 0;
+        static thread_local PerfCounters counters;
+        if (owner != ::getpid()) {
+          owner = ::getpid();
+          counters.open(CounterNames);
+        }
+        return counters.available() ? &counters: nullptr;
+      }
+
+      void readCounters(PerfCounters& counters, MetricList& metrics, double divisor) {
+        std::vector<double> values;
+        if (!counters.stop(values)) {
+          return;
+        }
+        const std::vector<std::string>& names(counters.names());
+        double cycles = 0.0,
+               instructions = 0.0;
+        for (std::size_t i = 0; i < values.size(); ++i) {
+          metrics.emplace_back(names[i], values[i] / divisor);
+          if (names[i] == "cycles") {
+            cycles = values[i];
+          }
+          else if (names[i] == "instructions") {
+            instructions = values[i];
+          }
+        }
+        if (cycles > 0.0 && instructions > 0.0) {
+          metrics.emplace_back("ipc", instructions / cycles);
+        }
+      }
+
+      // Longest processing time first: with the long tests out of the way
+      // early, the short ones fill in the gaps. Returns false, leaving the
+      // order alone, if there is no history to go by.
+      template<class TestPtrType>
+      bool longestFirst(std::vector<TestPtrType>& tests) const {
+        if (!History || History->empty()) {
+          return false;
+        }
+        const DurationHistory& history(*History);
+        std::stable_sort(tests.begin(), tests.end(), [&history](const TestPtrType& a, const TestPtrType& b) {
+          return history.expected(a->SourceFile, a->Name) > history.expected(b->SourceFile, b->Name);
+        });
+        return true;
+      }
+
+      // Visits the tests passing the filters and selections, in tree order.
+      // The answers are worked out on the first visit and kept in a bitset.
+      template<class VisitFnType>
+      void visitFiltered(VisitFnType&& fn) {
+        if (!FilterValid) {
+          filter();
+        }
+        std::size_t i = 0;
+        for (const TestTree::FileNode& file: Tree.files()) {
+          for (const TestTree::SuiteNode& suite: file.Suites) {
+            for (AutoRegister* test: suite.Tests) {
+              if (Filtered[i++]) {
+                fn(file, suite, test);
+              }
+            }
+          }
+        }
+      }
+
+      // A subtree at a time: the source filters are matched once per file,
+      // and the name filters only in files which those leave undecided.
+      void filter() {
+        const bool noIncludes = NameIncludes.empty() && SourceIncludes.empty();
+        Filtered.assign(NumTests, false);
+        std::size_t i = 0;
+        for (const TestTree::FileNode& file: Tree.files()) {
+          const bool excluded = SourceExcludes.matches(file.SourceFile),
+                     wholeFile = noIncludes || SourceIncludes.matches(file.SourceFile);
+          for (const TestTree::SuiteNode& suite: file.Suites) {
+            for (AutoRegister* test: suite.Tests) {
+              Filtered[i++] = !excluded && inSelection(file, suite, test)
+                && (wholeFile || NameIncludes.matches(test->Name))
+                && !NameExcludes.matches(test->Name)
+                && TagFilter.matches(test->Tags);
+            }
+          }
+        }
+        FilterValid = true;
+      }
+
+      bool inSelection(const TestTree::FileNode& file, const TestTree::SuiteNode& suite, const AutoRegister* test) const {
+        if (Selections.empty()) {
+          return true;
+        }
+        for (const TestTree::Path& path: Selections) {
+          if (path.File == &file && (!path.Suite || path.Suite == &suite) && (!path.Test || path.Test == test)) {
+            return true;
+          }
+        }
+        return false;
+      }
+
+      // the tests (or benchmarks) to run: filtered, then sharded
+      std::vector<AutoRegister*> chosen(bool benchmarks) {
+        std::vector<AutoRegister*> tests;
+        visitFiltered([benchmarks, &tests](const TestTree::FileNode&, const TestTree::SuiteNode&, AutoRegister* test) {
+          if (test->isBenchmark() == benchmarks) {
+            tests.push_back(test);
+          }
+        });
+        planShard(tests);
+        tests.erase(std::remove_if(tests.begin(), tests.end(), [this](const AutoRegister* test) {
+          return !this->inShard(test->SourceFile, test->Name);
+        }), tests.end());
+        return tests;
+      }
+
+      // shared is the test's suite fixture, if it has one and run() retained it
+      void execute(const TestCase& test, ResultSink& sink, SharedFixtureBase* shared = nullptr) {
+        ++NumRun;
+        TestResult result;
+        if (shared) {
+          // outside the test's measurements, and before any fork
+          shared->prepare();
+        }
+        if (Isolate || test.needsOwnProcess()) {
+          runIsolated(test, result, inProcessRunner(), &TheWatchdog, timeoutFor(test, Timeout));
+        }
+        else {
+          runInProcess(test, result);
+        }
+        finish(test, result, sink);
+        if (shared) {
+          reportTeardown(test, shared->release(), sink);
+        }
+      }
+
+      // under ResultsLock, like finish(), since other threads may be reporting
+      void reportTeardown(const TestCommon& test, const std::string& error, ResultSink& sink) {
+        if (!error.empty()) {
+          std::lock_guard<std::mutex> lock(ResultsLock);
+          sink.runError(std::string(test.SourceFile) + ": " + test.Name + ": " + error);
+        }
+      }
+
+      // points the tests in each suite which use the same kind of shared fixture at one instance
+      void shareSuiteFixtures() {
+        for (const TestTree::FileNode& file: Tree.files()) {
+          for (const TestTree::SuiteNode& suite: file.Suites) {
+            std::map<const void*, AutoRegister*> owners;
+            for (AutoRegister* test: suite.Tests) {
+              const void* key = test->sharedFixtureKey();
+              if (!key) {
+                continue;
+              }
+              auto it = owners.find(key);
+              if (it == owners.end()) {
+                owners.insert(std::make_pair(key, test));
+              }
+              else {
+                test->shareFixtureWith(*it->second);
+              }
+            }
+          }
+        }
+      }
+
+      bool selected(const TestCase& test) const {
+        const AutoRegister* reg = dynamic_cast<const AutoRegister*>(&test);
+        return matches(test.Name, test.SourceFile) && inShard(test.SourceFile, test.Name)
+          && TagFilter.matches(reg ? reg->Tags: 0);
+      }
+
+      bool matches(const std::string& name, const std::string& source) const {
+        const bool included = (NameIncludes.empty() && SourceIncludes.empty())
+          || NameIncludes.matches(name) || SourceIncludes.matches(source);
+        return included && !NameExcludes.matches(name) && !SourceExcludes.matches(source);
+      }
+
+      bool inShard(const std::string& source, const std::string& name) const {
+        if (TotalShards <= 1) {
+          return true;
+        }
+        if (ShardPlanned) {
+          return ShardMembers.count(DurationHistory::Key(source, name)) > 0;
+        }
+        return shardHash(source, name) % TotalShards == ShardIndex;
+      }
+
+      // With a shard history, bin-pack the tests (or benchmarks) which pass
+      // the filters; without one, inShard() falls back to hashing.
+      void planShard(const std::vector<AutoRegister*>& tests) {
+        ShardPlanned = false;
+        ShardMembers.clear();
+        if (TotalShards <= 1 || !ShardHistory || ShardHistory->empty()) {
+          return;
+        }
+        std::vector<ShardItem> items;
+        double known = 0.0;
+        std::size_t numKnown = 0;
+        for (const AutoRegister* cur: tests) {
+          const double cost = ShardHistory->expected(cur->SourceFile, cur->Name);
+          if (std::isfinite(cost)) {
+            known += cost;
+            ++numKnown;
+          }
+          items.push_back(ShardItem{cur->SourceFile, cur->Name, cost});
+        }
+        const double average = numKnown ? known / numKnown: 1.0;
+        for (ShardItem& item: items) {
+          if (!std::isfinite(item.Cost)) {
+            item.Cost = average;
+          }
+        }
+        const std::vector<unsigned int> plan(planShards(items, TotalShards));
+        for (std::size_t i = 0; i < items.size(); ++i) {
+          if (plan[i] == ShardIndex) {
+            ShardMembers.insert(DurationHistory::Key(items[i].SourceFile, items[i].Name));
+          }
+        }
+        ShardPlanned = true;
+      }
+
+      // The workers pull the chosen tests off the shared vector.
+      void runParallel(std::vector<AutoRegister*>& tests, ResultSink& sink) {
+        longestFirst(tests);
 
-      unsigned int  NumTests,
-                    NumRun;
-      bool          Debug;
+        const unsigned int numWorkers = std::min<unsigned int>(Jobs, std::max<std::size_t>(1, tests.size()));
+        std::vector<std::thread> workers;
+        std::atomic<std::size_t> next(0);
+
+        for (unsigned int i = 0; i < numWorkers; ++i) {
+          workers.emplace_back([this, &tests, &next, &sink]() {
+            for (std::size_t cur = next++; cur < tests.size(); cur = next++) {
+              this->execute(*tests[cur], sink, tests[cur]->sharedFixture());
+            }
+          });
+        }
+        for (auto& w: workers) {
+          w.join();
+        }
+      }
+
+      // The suite and snapshot fixtures are all built up front, so that
+      // every worker forked from the runner shares them, and torn down at
+      // the end.
+      void runPool(const std::vector<AutoRegister*>& tests, ResultSink& sink) {
+        std::vector<const TestCase*> chosen(tests.begin(), tests.end());
+        std::map<SharedFixtureBase*, const AutoRegister*> shared;
+        for (const AutoRegister* test: tests) {
+          SharedFixtureBase* fixture = test->sharedFixture();
+          if (fixture && shared.insert(std::make_pair(fixture, test)).second) {
+            fixture->prepare();
+          }
+        }
+        NumRun += chosen.size();
+        const std::size_t maxBatch = longestFirst(chosen) ? 1: 32;
+        // a worker runs many tests, so a test which needs its own process gets a child of the worker
+        const InProcessRunner inWorker = [this](const TestCase& test, TestResult& result) {
+          if (test.needsOwnProcess()) {
+            runIsolated(test, result, this->inProcessRunner(), nullptr, 0.0);
+          }
+          else {
+            this->runInProcess(test, result);
+          }
+        };
+        ProcessPool(chosen, inWorker, [this, &sink](const TestCase& test, TestResult& result) {
+          this->finish(test, result, sink);
+        }, Jobs, maxBatch, Timeout).run(sink);
+        for (const auto& fixture: shared) {
+          reportTeardown(*fixture.second, fixture.first->teardown(), sink);
+        }
+      }
+
+      GlobSet NameIncludes,
+              NameExcludes,
+              SourceIncludes,
+              SourceExcludes;
+      TagExpression TagFilter;
+      std::shared_ptr<DurationHistory> History;
+      std::shared_ptr<const DurationHistory> ShardHistory;
+      TestTree                    Tree;
+      std::vector<TestTree::Path> Selections;
+      std::vector<bool>           Filtered; // in tree order
+      bool                        FilterValid;
+
+      unsigned int  NumTests;
+      std::atomic<unsigned int> NumRun;
+      unsigned int  Jobs;
+      bool          Debug,
+                    Isolate,
+                    Pool,
+                    AllocReport,
+                    Leaks,
+                    ResourceReport;
+
+      std::vector<std::string>     CounterNames;
+      std::vector<TestMeasurement> Measurements;
+      MessageList                  Warnings;
+      std::mutex                   ResultsLock;
+
+      unsigned int ShardIndex,
+                   TotalShards;
+      bool         ShardPlanned;
+      std::set<DurationHistory::Key> ShardMembers;
+
+      double   Timeout;
+      Watchdog TheWatchdog;
+
+      std::vector<std::unique_ptr<SectionTest>> SectionTests;
+      std::vector<std::unique_ptr<AutoRegister>> ParamCases; // from expand()
     };
   }
 
@@ -134,8 +742,15 @@ namespace scope {
     return root;
   }
 
+  Node<AutoRegisterSuite>& TestRunner::suites(void) {
+    static Node<AutoRegisterSuite> suites;
+    return suites;
+  }
+
+  // each thread tracks its own current test, so that crash reports
+  // from worker threads name the right one
   std::string& TestRunner::lastTest(void) {
-    static std::string last;
+    static thread_local std::string last;
     return last;
   }
 
@@ -177,71 +792,432 @@ namespace scope {
     }
   }
 
+  void writeBenchmarks(std::ostream& out, const std::vector<BenchmarkResult>& results) {
+    std::size_t width = 9;
+    for (const BenchmarkResult& r: results) {
+      width = std::max(width, r.Name.size());
+    }
+    const int pct = results.empty() ? 95: static_cast<int>(std::round(results.front().Stats.Confidence * 100));
+    std::ostringstream ciHeader;
+    ciHeader << pct << "% CI";
+
+    out << std::left << std::setw(width) << "Benchmark" << std::right
+        << std::setw(12) << "mean ns/op"
+        << std::setw(24) << ciHeader.str()
+        << std::setw(12) << "median"
+        << std::setw(10) << "MAD"
+        << std::setw(12) << "min"
+        << std::setw(12) << "p90"
+        << std::setw(12) << "p99"
+        << std::setw(12) << "iterations"
+        << std::setw(9) << "samples" << '\n';
+    out << std::fixed << std::setprecision(2);
+    for (const BenchmarkResult& r: results) {
+      std::ostringstream ci;
+      ci << std::fixed << std::setprecision(2) << '[' << r.Stats.CiLow << ", " << r.Stats.CiHigh << ']';
+      out << std::left << std::setw(width) << r.Name << std::right
+          << std::setw(12) << r.NsPerOp
+          << std::setw(24) << ci.str()
+          << std::setw(12) << r.Stats.Median
+          << std::setw(10) << r.Stats.Mad
+          << std::setw(12) << r.Stats.Min
+          << std::setw(12) << r.Stats.P90
+          << std::setw(12) << r.Stats.P99
+          << std::setw(12) << r.Iterations
+          << std::setw(9) << r.Samples << '\n';
+    }
+    out.unsetf(std::ios::floatfield);
+    out << std::setprecision(6);
+
+    for (const BenchmarkResult& r: results) {
+      const SampleStats& st(r.Stats);
+      if (st.outliers()) {
+        out << r.Name << ": " << st.outliers() << " outliers among " << st.N << " samples ("
+            << st.LowSevere << " low severe, " << st.LowMild << " low mild, "
+            << st.HighMild << " high mild, " << st.HighSevere << " high severe)\n";
+      }
+    }
+  }
+
+  // prints failures as they are reported, as "file:line: test: message"
+  class TextSink: public ResultSink {
+  public:
+    TextSink(std::ostream& out): Out(out), NumFailures(0) {}
+
+    virtual void testFailed(const TestCommon& test, const Failure& failure) {
+      ++NumFailures;
+      if (!failure.File.empty()) {
+        Out << failure.File << ":" << failure.Line << ": ";
+      }
+      Out << test.Name << ": " << failure.Message << std::endl;
+    }
+
+    virtual void runError(const std::string& message) {
+      ++NumFailures;
+      Out << message << std::endl;
+    }
+
+    unsigned int failures() const {
+      return NumFailures;
+    }
+
+  private:
+    std::ostream& Out;
+    unsigned int  NumFailures;
+  };
+
+  // one row per test, one column per metric name, in order of first appearance
+  void writeMeasurements(std::ostream& out, const std::vector<TestMeasurement>& rows) {
+    std::vector<std::string> columns;
+    std::size_t width = 4;
+    for (const TestMeasurement& row: rows) {
+      width = std::max(width, row.Name.size());
+      for (const Metric& m: row.Metrics) {
+        if (std::find(columns.begin(), columns.end(), m.Name) == columns.end()) {
+          columns.push_back(m.Name);
+        }
+      }
+    }
+    out << std::left << std::setw(width) << "Test" << std::right;
+    for (const std::string& c: columns) {
+      out << std::setw(std::max<std::size_t>(14, c.size() + 2)) << c;
+    }
+    out << '\n';
+    for (const TestMeasurement& row: rows) {
+      out << std::left << std::setw(width) << row.Name << std::right;
+      for (const std::string& c: columns) {
+        const int w = static_cast<int>(std::max<std::size_t>(14, c.size() + 2));
+        auto m = std::find_if(row.Metrics.begin(), row.Metrics.end(), [&c](const Metric& m) { return m.Name == c; });
+        if (m == row.Metrics.end()) {
+          out << std::setw(w) << "-";
+        }
+        else {
+          out << std::setw(w) << std::fixed << std::setprecision(std::abs(m->Value) >= 100 || m->Value == std::floor(m->Value) ? 0: 2) << m->Value;
+        }
+      }
+      out << '\n';
+    }
+    out.unsetf(std::ios::floatfield);
+    out << std::setprecision(6);
+  }
+
+  // descending by the named metric; tests without it go last. False if no test has it.
+  bool sortMeasurements(std::vector<TestMeasurement>& rows, const std::string& column) {
+    auto find = [&column](const TestMeasurement& row) {
+      return std::find_if(row.Metrics.begin(), row.Metrics.end(), [&column](const Metric& m) { return m.Name == column; });
+    };
+    bool found = false;
+    for (const TestMeasurement& row: rows) {
+      found = found || find(row) != row.Metrics.end();
+    }
+    std::stable_sort(rows.begin(), rows.end(), [&find](const TestMeasurement& a, const TestMeasurement& b) {
+      auto ma = find(a),
+           mb = find(b);
+      if (mb == b.Metrics.end()) {
+        return ma != a.Metrics.end();
+      }
+      return ma != a.Metrics.end() && ma->Value > mb->Value;
+    });
+    return found;
+  }
+
+  // TCLAP wants "--name value"; also accept "--name=value"
+  std::vector<std::string> splitLongOptions(int argc, char** argv) {
+    std::vector<std::string> args;
+    for (int i = 0; i < argc; ++i) {
+      const std::string arg(argv[i]);
+      const std::size_t eq = arg.find('=');
+      if (i > 0 && arg.compare(0, 2, "--") == 0 && eq != std::string::npos) {
+        args.push_back(arg.substr(0, eq));
+        args.push_back(arg.substr(eq + 1));
+      }
+      else {
+        args.push_back(arg);
+      }
+    }
+    return args;
+  }
+
+  // "5%", "5" and "0.05%" are all percentages
+  bool parsePercent(const std::string& str, double& fraction) {
+    const char* begin = str.c_str();
+    char* end;
+    const double val = std::strtod(begin, &end);
+    if (end == begin || (*end && std::string(end) != "%") || val < 0.0) {
+      return false;
+    }
+    fraction = val / 100.0;
+    return true;
+  }
+
+  // regressions, and a baseline which cannot be used, go to sink.runError()
+  void checkBaseline(std::ostream& out, const std::string& path, double maxRegression, double significance,
+                     const std::vector<BenchmarkResult>& results, ResultSink& sink)
+  {
+    std::ifstream in(path.c_str());
+    if (!in) {
+      sink.runError("could not open baseline '" + path + "'");
+      return;
+    }
+    std::vector<BenchmarkResult> baseline;
+    std::string error;
+    if (!readBaseline(in, baseline, error)) {
+      sink.runError("could not read baseline '" + path + "': " + error);
+      return;
+    }
+    const std::vector<BaselineComparison> comps(compareBaseline(baseline, results, maxRegression, significance));
+    out << "Compared against " << path << '\n';
+    writeComparison(out, comps);
+    for (const BaselineComparison& c: comps) {
+      if (c.Regressed) {
+        std::ostringstream buf;
+        buf << c.Name << ": median is " << std::fixed << std::setprecision(1) << c.Delta * 100
+            << "% slower than baseline (p = " << std::setprecision(4) << c.PValue << ")";
+        sink.runError(buf.str());
+      }
+    }
+  }
+
   bool DefaultRun(std::ostream& out, int argc, char** argv) {
     TCLAP::CmdLine parser("Scope test", ' ', "version number? what's a version number?", true);
 
-    TCLAP::ValueArg<std::string> sourceFile("s", "source-filter", "Run tests from source files where the filenames match the provided regexp", false, "", "regexp", parser);
-    TCLAP::ValueArg<std::string> filter("f", "filter", "Only run test cases whose names match provided regexp", false, "", "regexp", parser);
+    TCLAP::MultiArg<std::string> sourceFile("s", "source-filter", "Run tests from source files whose names match this glob, e.g. 'net/*'; may be repeated", false, "glob", parser);
+    TCLAP::MultiArg<std::string> filter("f", "filter", "Only run tests whose names match this glob, e.g. 'parse*'; may be repeated", false, "glob", parser);
+    TCLAP::MultiArg<std::string> exclude("", "exclude", "Skip tests whose names match this glob, e.g. '*slow*'; may be repeated", false, "glob", parser);
+    TCLAP::MultiArg<std::string> excludeSource("", "exclude-source", "Skip tests from source files whose names match this glob; may be repeated", false, "glob", parser);
+    TCLAP::ValueArg<std::string> tags("", "tags", "Only run tests whose tags satisfy this expression, e.g. 'fast & !io'", false, "", "expression", parser);
+    TCLAP::MultiArg<std::string> select("", "select", "Only run this file, suite or test, given as file[::suite[::test]]; may be repeated", false, "path", parser);
+
+    TCLAP::ValueArg<unsigned int> jobs("j", "jobs", "Run tests on N worker threads (0 for one per hardware thread)", false, 1, "N", parser);
+
+    TCLAP::SwitchArg isolate("i", "isolate", "Run each test in its own child process, so that crashes fail only that test", parser);
+    TCLAP::SwitchArg pool("p", "pool", "Isolate tests in a pool of long-lived child processes, one per job", parser);
+    TCLAP::SwitchArg bench("b", "bench", "Run benchmarks instead of tests", parser);
+    TCLAP::ValueArg<unsigned int> benchSamples("", "bench-samples", "Number of timed samples to take of each benchmark", false, 30, "N", parser);
+    TCLAP::ValueArg<unsigned int> benchSampleMs("", "bench-sample-ms", "Minimum duration of a single benchmark sample, in milliseconds", false, 10, "ms", parser);
+
+    TCLAP::ValueArg<std::string> saveBaseline("", "save-baseline", "Save benchmark samples to a JSON baseline file", false, "", "file", parser);
+    TCLAP::ValueArg<std::string> compareTo("", "compare-baseline", "Compare benchmarks against a saved baseline and fail on significant regressions", false, "", "file", parser);
+    TCLAP::ValueArg<std::string> maxRegression("", "max-regression", "Largest slowdown of a benchmark's median tolerated by --compare-baseline", false, "5%", "percent", parser);
+    TCLAP::ValueArg<double> significance("", "significance", "p-value below which a slowdown counts as significant", false, 0.05, "p", parser);
+
+    TCLAP::ValueArg<std::string> counters("", "counters", "Read hardware performance counters around each test, e.g. cycles,instructions,cache-misses", false, "", "list", parser);
+
+    TCLAP::SwitchArg allocReport("", "alloc-report", "Report heap allocations made by each test (needs scope/alloccount.h)", parser);
+    TCLAP::SwitchArg leaks("", "leaks", "Warn about tests which allocate memory they do not free (needs scope/alloccount.h)", parser);
+    TCLAP::SwitchArg resourceReport("", "resource-report", "Report CPU time, page faults, context switches and peak RSS growth of each test", parser);
+    TCLAP::ValueArg<std::string> sortBy("", "sort-by", "Sort the measurements table by the named column, largest first, e.g. minor-faults", false, "", "column", parser);
+
+    TCLAP::ValueArg<std::string> history("", "history", "Keep test durations in a file, and run the longest tests first with -j or -p", false, "", "file", parser);
+
+    TCLAP::ValueArg<std::string> timeout("t", "timeout", "Fail tests which run longer than this, e.g. 30s or 500ms; without -i or -p, abort the run", false, "", "duration", parser);
+
+    TCLAP::ValueArg<unsigned int> shardIndex("", "shard-index", "Run only this shard of the selected tests, counting from 0", false, 0, "i", parser);
+    TCLAP::ValueArg<unsigned int> totalShards("", "total-shards", "Split the selected tests into this many disjoint shards", false, 1, "n", parser);
+    TCLAP::ValueArg<std::string> shardHistory("", "shard-history", "Balance shards by the durations in this history file, which is only read; give every shard the same one", false, "", "file", parser);
+
+    TCLAP::ValueArg<std::string> reporter("", "reporter", "Also write results to --report-file as junit, jsonl or tap", false, "", "format", parser);
+    TCLAP::ValueArg<std::string> reportFile("", "report-file", "File for --reporter, written as tests finish", false, "", "file", parser);
 
     TCLAP::SwitchArg verbose("v", "verbose", "Print debugging info", parser);
     TCLAP::SwitchArg list("l", "list", "List test names", parser);
 
     try {
-      parser.parse(argc, argv);
+      std::vector<std::string> args(splitLongOptions(argc, argv));
+      parser.parse(args);
     }
     catch (TCLAP::ArgException& e) {
       std::cerr << "Error: " << e.error() << " for argument " << e.argId() << std::endl;
       return false;
     }
 
-    MessageList msgs;
-    TestRunnerImpl runner;
-    std::string f(filter.getValue());
-    if (!f.empty()) {
-      try {
-        runner.setFilter(std::make_shared<std::regex>(f));
+    double maxRegressionFraction;
+    if (!parsePercent(maxRegression.getValue(), maxRegressionFraction)) {
+      std::cerr << "Error: --max-regression must be a percentage, e.g. 5%" << std::endl;
+      return false;
+    }
+
+    if ((!saveBaseline.getValue().empty() || !compareTo.getValue().empty()) && !bench.getValue()) {
+      std::cerr << "Error: --save-baseline and --compare-baseline need --bench" << std::endl;
+      return false;
+    }
+
+    if (totalShards.getValue() == 0 || shardIndex.getValue() >= totalShards.getValue()) {
+      std::cerr << "Error: --shard-index must be less than --total-shards" << std::endl;
+      return false;
+    }
+
+    double timeoutSeconds = 0.0;
+    if (!timeout.getValue().empty() && !parseDuration(timeout.getValue(), timeoutSeconds)) {
+      std::cerr << "Error: --timeout must be a duration, e.g. 30s or 500ms" << std::endl;
+      return false;
+    }
+
+    std::vector<std::string> counterNames;
+    std::string counterError;
+    if (!parseCounterList(counters.getValue(), counterNames, counterError)) {
+      std::cerr << "Error: " << counterError << std::endl;
+      return false;
+    }
+
+    TextSink text(out);
+    TeeSink sinks;
+    sinks.add(text);
+    std::ofstream reportOut;
+    std::unique_ptr<Reporter> report;
+    if (!reporter.getValue().empty()) {
+      if (reportFile.getValue().empty()) {
+        std::cerr << "Error: --reporter needs a --report-file" << std::endl;
+        return false;
       }
-      catch (std::regex_error& e) {
-        std::cerr << "Error with filter regexp '" << f << "': " << e.what() << std::endl;
+      reportOut.open(reportFile.getValue().c_str());
+      if (!reportOut) {
+        std::cerr << "Error: could not open report file '" << reportFile.getValue() << "'" << std::endl;
         return false;
       }
+      report = makeReporter(reporter.getValue(), reportOut);
+      if (!report) {
+        std::cerr << "Error: --reporter must be junit, jsonl or tap" << std::endl;
+        return false;
+      }
+      sinks.add(*report);
     }
-    std::string s(sourceFile.getValue());
-    if (!s.empty()) {
-      try {
-        runner.setSourceFilter(std::make_shared<std::regex>(s));
+
+    TestRunnerImpl runner;
+    auto globs = [](const std::vector<std::string>& patterns) {
+      GlobSet set;
+      for (const std::string& p: patterns) {
+        set.add(p);
       }
-      catch (std::regex_error& e) {
-        std::cerr << "Error with filter regexp '" << s << "': " << e.what() << std::endl;
+      return set;
+    };
+    runner.setFilter(globs(filter.getValue()), globs(exclude.getValue()));
+    runner.setSourceFilter(globs(sourceFile.getValue()), globs(excludeSource.getValue()));
+
+    if (tagTable().Overflowed) {
+      std::cerr << "Error: more than " << int(TagTable::MaxTags) << " distinct tags are registered" << std::endl;
+      return false;
+    }
+    if (!tags.getValue().empty()) {
+      TagExpression expr;
+      std::string tagError;
+      if (!expr.parse(tags.getValue(), tagError)) {
+        std::cerr << "Error: " << tagError << std::endl;
+        return false;
+      }
+      for (const std::string& name: expr.unknown()) {
+        std::cerr << "Warning: no test is tagged '" << name << "'" << std::endl;
+      }
+      runner.setTags(expr);
+    }
+
+    for (const std::string& path: select.getValue()) {
+      if (!runner.select(path)) {
+        std::cerr << "Error: no file, suite or test '" << path << "' to select" << std::endl;
         return false;
       }
     }
 
     if (list.getValue()) {
-      runner.traverse([](AutoRegister* cur) { std::cerr << cur->TestName << '\t' << cur->SourceFile << '\n'; });
+      runner.list(std::cerr);
       return true;
     }
     if (verbose.getValue()) {
       runner.setDebug(true);
       out << "Running in debug mode" << std::endl;
     }
+    runner.setJobs(jobs.getValue());
+    runner.setIsolate(isolate.getValue());
+    runner.setPool(pool.getValue());
+    runner.setCounters(counterNames);
+    runner.setAllocReport(allocReport.getValue());
+    runner.setLeakCheck(leaks.getValue());
+    runner.setResourceReport(resourceReport.getValue());
+    runner.setShard(shardIndex.getValue(), totalShards.getValue());
+    runner.setTimeout(timeoutSeconds);
+    std::shared_ptr<DurationHistory> durations;
+    if (!history.getValue().empty()) {
+      durations = std::make_shared<DurationHistory>();
+      std::ifstream historyFile(history.getValue().c_str());
+      // a missing file just means no history yet
+      if (historyFile && !durations->load(historyFile)) {
+        std::cerr << "Warning: could not parse history '" << history.getValue() << "'; starting over" << std::endl;
+        durations = std::make_shared<DurationHistory>();
+      }
+      runner.setHistory(durations);
+    }
+    if (!shardHistory.getValue().empty()) {
+      auto plan = std::make_shared<DurationHistory>();
+      std::ifstream planFile(shardHistory.getValue().c_str());
+      if (!planFile || !plan->load(planFile)) {
+        std::cerr << "Error: could not read shard history '" << shardHistory.getValue() << "'" << std::endl;
+        return false;
+      }
+      runner.setShardHistory(plan);
+    }
+    if ((allocReport.getValue() || leaks.getValue()) && !allocationCountingInstalled()) {
+      std::cerr << "Warning: --alloc-report and --leaks need scope/alloccount.h in one source file; no allocations will be reported" << std::endl;
+    }
+    std::vector<BenchmarkResult> benchmarks;
+    BenchmarkOptions benchOpts;
+    benchOpts.Samples = benchSamples.getValue();
+    benchOpts.MinSampleTime = std::chrono::milliseconds(benchSampleMs.getValue());
+
     setHandlers(handleSignal);
     std::set_terminate(&handleTerminate);
-    runner.run(msgs);
+    if (bench.getValue()) {
+      runner.runBenchmarks(benchOpts, benchmarks, sinks);
+    }
+    else {
+      runner.run(sinks);
+    }
     std::set_terminate(0);
     setHandlers(SIG_DFL);
 
-    for(const std::string& m : msgs) {
-      out << m << '\n';
+    if (durations) {
+      std::ofstream historyFile(history.getValue().c_str());
+      durations->save(historyFile);
+      if (!historyFile) {
+        std::cerr << "Warning: could not write history '" << history.getValue() << "'" << std::endl;
+      }
+    }
+
+    if (!benchmarks.empty()) {
+      writeBenchmarks(out, benchmarks);
+    }
+    if (!runner.measurements().empty()) {
+      std::vector<TestMeasurement> rows(runner.measurements());
+      if (!sortBy.getValue().empty() && !sortMeasurements(rows, sortBy.getValue())) {
+        std::cerr << "Warning: no test reported '" << sortBy.getValue() << "', so the measurements are not sorted" << std::endl;
+      }
+      out << (bench.getValue() ? "Measurements per iteration\n": "Measurements\n");
+      writeMeasurements(out, rows);
+    }
+    if (!saveBaseline.getValue().empty()) {
+      std::ofstream baselineFile(saveBaseline.getValue().c_str());
+      writeBaseline(baselineFile, benchmarks);
+      if (!baselineFile) {
+        sinks.runError("could not write baseline '" + saveBaseline.getValue() + "'");
+      }
+    }
+    if (!compareTo.getValue().empty()) {
+      checkBaseline(out, compareTo.getValue(), maxRegressionFraction, significance.getValue(), benchmarks, sinks);
+    }
+
+    for(const std::string& m : runner.warnings()) {
+      out << "Warning: " << m << '\n';
+    }
+    if (report) {
+      report->runFinished();
     }
 
-    if (msgs.empty()) {
+    if (!text.failures()) {
       out << "OK (" << runner.numRun() << " tests)" << std::endl;
       return true;
     }
     else {
       out << "Failures!" << std::endl;
-      out << "Tests run: " << runner.numRun() << ", Failures: " << msgs.size() << std::endl;
+      out << "Tests run: " << runner.numRun() << ", Failures: " << text.failures() << std::endl;
       return false;
     }
   }
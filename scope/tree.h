@@ -0,0 +1,165 @@
+/*
+  © 2016, Jon Stewart
+  Released under the terms of the Boost license (http://www.boost.org/LICENSE_1_0.txt). See License.txt for details.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "test.h"
+
+/**************************** Test tree *****************************
+
+  The runner indexes the registered tests once, when it starts, as a tree:
+
+    source file
+      suite       from SCOPE_SUITE(name); the tests above the first one in
+                  a file are in an unnamed suite
+        test
+
+  Files are in name order, and tests in source order. Filtering, listing
+  and sharding work on whole subtrees: a file whose name matches -s is
+  taken whole, a file which does not is skipped without looking at its
+  tests (unless there is a -f as well), and a --select path,
+  file[::suite[::test]], is looked up rather than matched against every
+  test in the binary.
+*/
+
+namespace scope {
+  class TestTree {
+  public:
+    struct SuiteNode {
+      std::string                Name; // empty for the unnamed suite
+      int                        Line;
+      std::vector<AutoRegister*> Tests;
+    };
+
+    struct FileNode {
+      std::string            SourceFile;
+      std::vector<SuiteNode> Suites; // in line order, the unnamed suite first
+    };
+
+    // a subtree; a null Suite or Test stands for all of them
+    struct Path {
+      const FileNode*     File;
+      const SuiteNode*    Suite;
+      const AutoRegister* Test;
+    };
+
+    // suites may be added before or after the tests in them, but all before finish()
+    void addSuite(const std::string& source, const std::string& name, int line) {
+      file(source).Suites.push_back(SuiteNode{name, line, std::vector<AutoRegister*>()});
+    }
+
+    void addTest(AutoRegister* test) {
+      file(test->SourceFile).Suites.front().Tests.push_back(test);
+    }
+
+    // sorts everything and puts each test in the last suite starting above it
+    void finish() {
+      std::sort(Files.begin(), Files.end(), [](const FileNode& a, const FileNode& b) {
+        return a.SourceFile < b.SourceFile;
+      });
+      FileIndex.clear();
+      for (std::size_t i = 0; i < Files.size(); ++i) {
+        FileIndex[Files[i].SourceFile] = i;
+
+        std::vector<SuiteNode>& suites(Files[i].Suites);
+        std::vector<AutoRegister*> tests;
+        tests.swap(suites.front().Tests);
+        std::stable_sort(suites.begin() + 1, suites.end(), [](const SuiteNode& a, const SuiteNode& b) {
+          return a.Line < b.Line;
+        });
+        std::stable_sort(tests.begin(), tests.end(), [](const AutoRegister* a, const AutoRegister* b) {
+          return a->Line < b->Line;
+        });
+        for (AutoRegister* test: tests) {
+          auto suite = std::upper_bound(suites.begin() + 1, suites.end(), test->Line, [](int line, const SuiteNode& s) {
+            return line < s.Line;
+          });
+          (suite - 1)->Tests.push_back(test);
+        }
+      }
+    }
+
+    const std::vector<FileNode>& files() const {
+      return Files;
+    }
+
+    // "file", "file::suite", "file::suite::test", or "file::test" for a test in no suite
+    bool find(const std::string& path, Path& out) const {
+      std::vector<std::string> parts;
+      std::size_t begin = 0;
+      for (std::size_t sep = path.find("::"); sep != std::string::npos; sep = path.find("::", begin)) {
+        parts.push_back(path.substr(begin, sep - begin));
+        begin = sep + 2;
+      }
+      parts.push_back(path.substr(begin));
+      if (parts.size() > 3) {
+        return false;
+      }
+
+      auto it = FileIndex.find(parts[0]);
+      if (it == FileIndex.end()) {
+        return false;
+      }
+      out.File = &Files[it->second];
+      out.Suite = nullptr;
+      out.Test = nullptr;
+      if (parts.size() == 1) {
+        return true;
+      }
+
+      out.Suite = suite(*out.File, parts[1]);
+      if (!out.Suite) {
+        if (parts.size() == 3) {
+          return false;
+        }
+        out.Suite = &out.File->Suites.front();
+        out.Test = test(*out.Suite, parts[1]);
+        return out.Test != nullptr;
+      }
+      if (parts.size() == 3) {
+        out.Test = test(*out.Suite, parts[2]);
+        return out.Test != nullptr;
+      }
+      return true;
+    }
+
+  private:
+    FileNode& file(const std::string& source) {
+      auto it = FileIndex.find(source);
+      if (it != FileIndex.end()) {
+        return Files[it->second];
+      }
+      FileIndex[source] = Files.size();
+      Files.push_back(FileNode{source, std::vector<SuiteNode>(1, SuiteNode{"", 0, std::vector<AutoRegister*>()})});
+      return Files.back();
+    }
+
+    static const SuiteNode* suite(const FileNode& file, const std::string& name) {
+      for (auto it = file.Suites.begin() + 1; it != file.Suites.end(); ++it) {
+        if (it->Name == name) {
+          return &*it;
+        }
+      }
+      return nullptr;
+    }
+
+    static const AutoRegister* test(const SuiteNode& suite, const std::string& name) {
+      for (const AutoRegister* t: suite.Tests) {
+        if (t->Name == name) {
+          return t;
+        }
+      }
+      return nullptr;
+    }
+
+    std::vector<FileNode>              Files;
+    std::map<std::string, std::size_t> FileIndex;
+  };
+}
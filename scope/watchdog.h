@@ -0,0 +1,192 @@
+/*
+  © 2016, Jon Stewart
+  Released under the terms of the Boost license (http://www.boost.org/LICENSE_1_0.txt). See License.txt for details.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include <signal.h>
+#include <sys/types.h>
+
+/**************************** Timeouts *****************************
+
+  With --timeout, or a limit given at registration with SCOPE_TEST_TIMEOUT()
+  or SCOPE_FIXTURE_TIMEOUT(), a test which runs too long is stopped and
+  reported instead of hanging the whole run.
+
+  A Watchdog is a single thread which sleeps until the earliest deadline of
+  the tests it has been armed for. When a test overruns, the watchdog says
+  which one and for how long it has been running. If the test is in a child
+  process (--isolate), the child is killed and the test fails with a
+  timeout; the run goes on. A test running in the runner itself cannot be
+  stopped safely, so the watchdog aborts the whole process, which at least
+  ends the run with the name of the culprit rather than at the hands of the
+  CI system's global timeout. The process pool does without a watchdog,
+  since it already waits on its children with poll(), and can time that out.
+
+  Children never touch the watchdog: it is a thread of the parent, and a
+  child forked while the thread held the lock would deadlock on it.
+*/
+
+namespace scope {
+  // "30s", "500ms", "2m", or plain seconds
+  inline bool parseDuration(const std::string& str, double& seconds) {
+    const char* begin = str.c_str();
+    char* end;
+    const double val = std::strtod(begin, &end);
+    if (end == begin || val < 0.0) {
+      return false;
+    }
+    const std::string unit(end);
+    if (unit.empty() || unit == "s") {
+      seconds = val;
+    }
+    else if (unit == "ms") {
+      seconds = val / 1000;
+    }
+    else if (unit == "m") {
+      seconds = val * 60;
+    }
+    else {
+      return false;
+    }
+    return true;
+  }
+
+  inline std::string describeTimeout(double limit) {
+    std::ostringstream buf;
+    buf << "timed out after " << limit << "s";
+    return buf.str();
+  }
+
+  // to stderr, as soon as a test overruns, since it may never be reported otherwise
+  inline void reportOverdue(const std::string& name, double elapsed, double limit, const char* action, std::ostream& out = std::cerr) {
+    std::ostringstream buf;
+    buf << "Timeout: " << name << " has run for " << std::fixed << std::setprecision(1) << elapsed
+        << "s, over its limit of " << std::defaultfloat << std::setprecision(6) << limit << "s" << action;
+    out << buf.str() << std::endl;
+  }
+
+  class Watchdog {
+  public:
+    typedef std::chrono::steady_clock Clock;
+
+    // out gets the overdue reports, from the watchdog's thread
+    explicit Watchdog(std::ostream& out = std::cerr): Out(out), NextId(0), Stopping(false) {}
+
+    Watchdog(const Watchdog&) = delete;
+    Watchdog& operator=(const Watchdog&) = delete;
+
+    ~Watchdog() {
+      {
+        std::lock_guard<std::mutex> lock(Lock);
+        Stopping = true;
+      }
+      Wake.notify_one();
+      if (Thread.joinable()) {
+        Thread.join();
+      }
+    }
+
+    // Past the limit, kills pid, or aborts if pid is 0. Returns an id for disarm().
+    unsigned int arm(const std::string& name, double limit, pid_t pid) {
+      Entry e;
+      e.Name = name;
+      e.Limit = limit;
+      e.Start = Clock::now();
+      e.Deadline = e.Start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(limit));
+      e.Pid = pid;
+      e.Fired = false;
+
+      std::lock_guard<std::mutex> lock(Lock);
+      if (!Thread.joinable()) {
+        Thread = std::thread([this]() { this->watch(); });
+      }
+      const unsigned int id = NextId++;
+      Entries.insert(std::make_pair(id, e));
+      Wake.notify_one();
+      return id;
+    }
+
+    // true if the watchdog had already fired
+    bool disarm(unsigned int id) {
+      std::lock_guard<std::mutex> lock(Lock);
+      auto it = Entries.find(id);
+      if (it == Entries.end()) {
+        return false;
+      }
+      const bool fired = it->second.Fired;
+      Entries.erase(it);
+      return fired;
+    }
+
+  private:
+    struct Entry {
+      std::string       Name;
+      double            Limit;
+      Clock::time_point Start,
+                        Deadline;
+      pid_t             Pid;
+      bool              Fired;
+    };
+
+    void watch() {
+      std::unique_lock<std::mutex> lock(Lock);
+      while (!Stopping) {
+        const Clock::time_point now = Clock::now();
+        Clock::time_point next = Clock::time_point::max();
+        for (auto& entry: Entries) {
+          Entry& e(entry.second);
+          if (e.Fired) {
+            continue;
+          }
+          if (e.Deadline <= now) {
+            fire(e, now);
+          }
+          else {
+            next = std::min(next, e.Deadline);
+          }
+        }
+        if (next == Clock::time_point::max()) {
+          Wake.wait(lock);
+        }
+        else {
+          Wake.wait_until(lock, next);
+        }
+      }
+    }
+
+    void fire(Entry& e, Clock::time_point now) {
+      const double elapsed = std::chrono::duration<double>(now - e.Start).count();
+      if (e.Pid > 0) {
+        reportOverdue(e.Name, elapsed, e.Limit, "; killing it", Out);
+        ::kill(e.Pid, SIGKILL);
+        e.Fired = true;
+      }
+      else {
+        reportOverdue(e.Name, elapsed, e.Limit, ". Aborting.", Out);
+        std::abort();
+      }
+    }
+
+    std::ostream&           Out;
+    std::map<unsigned int, Entry> Entries;
+    unsigned int            NextId;
+    bool                    Stopping;
+    std::mutex              Lock;
+    std::condition_variable Wake;
+    std::thread             Thread;
+  };
+}
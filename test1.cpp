@@ -129,3 +129,24 @@ SCOPE_TEST(nulls) {
   // SCOPE_ASSERT_EQUAL(0, z);
 //  SCOPE_ASSERT_EQUAL(null, x);
 }
+
+SCOPE_TEST(failureKeepsOperands) {
+  scope::TestCommon info("unequal", __FILE__);
+  scope::TestResult result;
+  scope::runFunction([]() { SCOPE_ASSERT_EQUAL(41, 42); }, info, false, result);
+  SCOPE_ASSERT_EQUAL(1u, result.Failures.size());
+  const scope::Failure& f(result.Failures.front());
+  SCOPE_ASSERT_EQUAL(std::string(__FILE__), f.File);
+  SCOPE_ASSERT(f.Line > 0);
+  SCOPE_ASSERT_EQUAL("41", f.Expected);
+  SCOPE_ASSERT_EQUAL("42", f.Actual);
+}
+
+SCOPE_TEST(exceptionFailureHasNoLocation) {
+  scope::TestCommon info("throws", __FILE__);
+  scope::TestResult result;
+  scope::runFunction([]() { throw std::runtime_error("oops"); }, info, false, result);
+  SCOPE_ASSERT_EQUAL(1u, result.Failures.size());
+  SCOPE_ASSERT(result.Failures.front().File.empty());
+  SCOPE_ASSERT_EQUAL("oops", result.Failures.front().Message);
+}
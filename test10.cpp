@@ -0,0 +1,40 @@
+/*
+	© 2016, Jon Stewart
+	Released under the terms of the Boost license (http://www.boost.org/LICENSE_1_0.txt). See License.txt for details.
+*/
+
+#define SCOPE_SECTION_REGISTRATION
+#include "scope/test.h"
+
+#include <cstring>
+
+SCOPE_TEST(sectionRegisteredTest) {
+  SCOPE_ASSERT(true);
+}
+
+SCOPE_TEST_FAILS(sectionRegisteredFailingTest) {
+  SCOPE_ASSERT(false);
+}
+
+SCOPE_TEST_TIMEOUT(sectionRegisteredTimeout, 60) {
+  SCOPE_ASSERT(true);
+}
+
+SCOPE_TEST(sectionDescriptorsAreFound) {
+#if defined(SCOPE_HAS_SECTION_REGISTRATION)
+  const auto descs(scope::sectionTests());
+  SCOPE_ASSERT(descs.first != nullptr);
+  bool sawFailing = false,
+       sawTimeout = false;
+  for (const scope::TestDescriptor* d = descs.first; d != descs.second; ++d) {
+    if (std::strcmp(d->Name, "sectionRegisteredFailingTest") == 0) {
+      sawFailing = (d->Flag & scope::TestDescriptor::ShouldFail) != 0;
+    }
+    if (std::strcmp(d->Name, "sectionRegisteredTimeout") == 0) {
+      sawTimeout = d->Timeout == 60 && d->Line > 0;
+    }
+  }
+  SCOPE_ASSERT(sawFailing);
+  SCOPE_ASSERT(sawTimeout);
+#endif
+}
@@ -0,0 +1,78 @@
+/*
+	© 2016, Jon Stewart
+	Released under the terms of the Boost license (http://www.boost.org/LICENSE_1_0.txt). See License.txt for details.
+*/
+
+#include "scope/test.h"
+#include "scope/tree.h"
+
+namespace {
+  void nothing() {}
+
+  scope::TestTree::Path findPath(const scope::TestTree& tree, const std::string& path) {
+    scope::TestTree::Path found = {nullptr, nullptr, nullptr};
+    SCOPE_ASSERT(tree.find(path, found));
+    return found;
+  }
+}
+
+SCOPE_TEST(treeOutsideAnySuite) {
+  SCOPE_ASSERT(true);
+}
+
+SCOPE_SUITE(treeSuite)
+
+SCOPE_TEST(treeInSuite) {
+  SCOPE_ASSERT(true);
+}
+
+SCOPE_TEST(treePlacesTestsInSuitesByLine) {
+  scope::BoundTest a("a", "x.cpp", nothing, false, 0.0, 5),
+                   b("b", "x.cpp", nothing, false, 0.0, 20),
+                   c("c", "x.cpp", nothing, false, 0.0, 40),
+                   d("d", "w.cpp", nothing, false, 0.0, 3);
+  scope::TestTree tree;
+  tree.addTest(&c);
+  tree.addTest(&b);
+  tree.addSuite("x.cpp", "second", 30);
+  tree.addSuite("x.cpp", "first", 10);
+  tree.addTest(&a);
+  tree.addTest(&d);
+  tree.finish();
+
+  SCOPE_ASSERT_EQUAL(2u, tree.files().size());
+  SCOPE_ASSERT_EQUAL("w.cpp", tree.files()[0].SourceFile);
+  const scope::TestTree::FileNode& x(tree.files()[1]);
+  SCOPE_ASSERT_EQUAL(3u, x.Suites.size());
+  SCOPE_ASSERT_EQUAL("", x.Suites[0].Name);
+  SCOPE_ASSERT_EQUAL("first", x.Suites[1].Name);
+  SCOPE_ASSERT_EQUAL("second", x.Suites[2].Name);
+  SCOPE_ASSERT_EQUAL(1u, x.Suites[0].Tests.size());
+  SCOPE_ASSERT(x.Suites[0].Tests[0] == &a);
+  SCOPE_ASSERT(x.Suites[1].Tests[0] == &b);
+  SCOPE_ASSERT(x.Suites[2].Tests[0] == &c);
+}
+
+SCOPE_TEST(treeFindsPaths) {
+  scope::BoundTest a("a", "x.cpp", nothing, false, 0.0, 5),
+                   b("b", "x.cpp", nothing, false, 0.0, 20);
+  scope::TestTree tree;
+  tree.addSuite("x.cpp", "s", 10);
+  tree.addTest(&a);
+  tree.addTest(&b);
+  tree.finish();
+
+  scope::TestTree::Path p(findPath(tree, "x.cpp"));
+  SCOPE_ASSERT(!p.Suite && !p.Test);
+  p = findPath(tree, "x.cpp::s");
+  SCOPE_ASSERT(p.Suite == &tree.files()[0].Suites[1] && !p.Test);
+  p = findPath(tree, "x.cpp::s::b");
+  SCOPE_ASSERT(p.Test == &b);
+  p = findPath(tree, "x.cpp::a");
+  SCOPE_ASSERT(p.Test == &a);
+
+  SCOPE_ASSERT(!tree.find("y.cpp", p));
+  SCOPE_ASSERT(!tree.find("x.cpp::b", p));
+  SCOPE_ASSERT(!tree.find("x.cpp::s::a", p));
+  SCOPE_ASSERT(!tree.find("x.cpp::s::b::c", p));
+}
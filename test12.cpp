@@ -0,0 +1,51 @@
+/*
+	© 2016, Jon Stewart
+	Released under the terms of the Boost license (http://www.boost.org/LICENSE_1_0.txt). See License.txt for details.
+*/
+
+#include "scope/test.h"
+#include "scope/filter.h"
+
+SCOPE_TEST(globMatchWildcards) {
+  SCOPE_ASSERT(scope::globMatch("net*", "netSocket"));
+  SCOPE_ASSERT(scope::globMatch("*slow*", "parseSlowly") == false);
+  SCOPE_ASSERT(scope::globMatch("*slow*", "a_slow_test"));
+  SCOPE_ASSERT(scope::globMatch("a?c", "abc"));
+  SCOPE_ASSERT(!scope::globMatch("a?c", "ac"));
+  SCOPE_ASSERT(scope::globMatch("*", ""));
+  SCOPE_ASSERT(scope::globMatch("a*b*c", "aXbYbZc"));
+  SCOPE_ASSERT(!scope::globMatch("a*b*c", "aXbYbZ"));
+  SCOPE_ASSERT(!scope::globMatch("abc", "abcd"));
+}
+
+SCOPE_TEST(globSetUsesTrieAndGlobs) {
+  scope::GlobSet set;
+  SCOPE_ASSERT(set.empty());
+  SCOPE_ASSERT(!set.matches("anything"));
+
+  set.add("simpleTest");
+  set.add("net*");
+  set.add("*Equality");
+  SCOPE_ASSERT(!set.empty());
+
+  SCOPE_ASSERT(set.matches("simpleTest"));
+  SCOPE_ASSERT(!set.matches("simpleTes"));
+  SCOPE_ASSERT(!set.matches("simpleTests"));
+  SCOPE_ASSERT(set.matches("net"));
+  SCOPE_ASSERT(set.matches("netSocket"));
+  SCOPE_ASSERT(!set.matches("ne"));
+  SCOPE_ASSERT(set.matches("setEquality"));
+  SCOPE_ASSERT(!set.matches("setInequalities"));
+}
+
+SCOPE_TEST(globSetPrefixesShareNodes) {
+  scope::GlobSet set;
+  set.add("ab");
+  set.add("abc*");
+  set.add("");
+  SCOPE_ASSERT(set.matches(""));
+  SCOPE_ASSERT(set.matches("ab"));
+  SCOPE_ASSERT(!set.matches("a"));
+  SCOPE_ASSERT(set.matches("abcdef"));
+  SCOPE_ASSERT(!set.matches("abd"));
+}
@@ -0,0 +1,77 @@
+/*
+	© 2016, Jon Stewart
+	Released under the terms of the Boost license (http://www.boost.org/LICENSE_1_0.txt). See License.txt for details.
+*/
+
+#include "scope/test.h"
+
+#include <string>
+
+namespace {
+  struct Counter {
+    int Count = 0;
+  };
+
+  scope::TagExpression compile(const std::string& expr) {
+    scope::TagExpression compiled;
+    std::string error;
+    SCOPE_ASSERT(compiled.parse(expr, error));
+    return compiled;
+  }
+}
+
+SCOPE_TEST_TAGS(taggedSlowIo, "slow, io") {
+  SCOPE_ASSERT(true);
+}
+
+SCOPE_FIXTURE_TAGS(taggedFixture, Counter, "io") {
+  SCOPE_ASSERT_EQUAL(0, fixture.Count);
+}
+
+SCOPE_TEST(tagsInternToBits) {
+  const uint64_t slowIo = scope::internTags("slow, io"),
+                 io = scope::internTags("io");
+  SCOPE_ASSERT(io != 0);
+  SCOPE_ASSERT_EQUAL(io, slowIo & io);
+  SCOPE_ASSERT(slowIo != io);
+  SCOPE_ASSERT_EQUAL(slowIo, scope::internTags("io,slow"));
+  SCOPE_ASSERT_EQUAL(0u, scope::internTags(""));
+  SCOPE_ASSERT_EQUAL("slow,io", scope::tagNames(slowIo));
+}
+
+SCOPE_TEST(tagExpressionsEvaluate) {
+  const uint64_t slow = scope::internTags("slow"),
+                 io = scope::internTags("io"),
+                 gpu = scope::internTags("gpu-free");
+
+  const scope::TagExpression notIo(compile("!io"));
+  SCOPE_ASSERT(notIo.matches(slow));
+  SCOPE_ASSERT(!notIo.matches(slow | io));
+
+  const scope::TagExpression both(compile("slow & (io | gpu-free)"));
+  SCOPE_ASSERT(both.matches(slow | io));
+  SCOPE_ASSERT(both.matches(slow | gpu));
+  SCOPE_ASSERT(!both.matches(slow));
+  SCOPE_ASSERT(!both.matches(io | gpu));
+
+  const scope::TagExpression precedence(compile("io | slow & !gpu-free"));
+  SCOPE_ASSERT(precedence.matches(io | gpu));
+  SCOPE_ASSERT(precedence.matches(slow));
+  SCOPE_ASSERT(!precedence.matches(slow | gpu));
+
+  SCOPE_ASSERT(scope::TagExpression().matches(0));
+}
+
+SCOPE_TEST(tagExpressionsReportProblems) {
+  scope::TagExpression expr;
+  std::string error;
+  SCOPE_ASSERT(!expr.parse("slow &", error));
+  SCOPE_ASSERT(!error.empty());
+  SCOPE_ASSERT(!expr.parse("(slow", error));
+  SCOPE_ASSERT(!expr.parse("slow io", error));
+
+  SCOPE_ASSERT(expr.parse("fast & !io", error));
+  SCOPE_ASSERT_EQUAL(1u, expr.unknown().size());
+  SCOPE_ASSERT_EQUAL("fast", expr.unknown().front());
+  SCOPE_ASSERT(!expr.matches(scope::internTags("io")));
+}
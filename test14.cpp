@@ -0,0 +1,79 @@
+/*
+	© 2016, Jon Stewart
+	Released under the terms of the Boost license (http://www.boost.org/LICENSE_1_0.txt). See License.txt for details.
+*/
+
+#include "scope/test.h"
+
+#include <stdexcept>
+#include <vector>
+
+namespace {
+  struct Dataset {
+    static int Builds;
+
+    std::vector<int> Rows;
+
+    Dataset(): Rows(1000, 7) {
+      ++Builds;
+    }
+  };
+
+  int Dataset::Builds = 0;
+
+  struct Counted {
+    static int Live;
+
+    Counted() { ++Live; }
+    ~Counted() { --Live; }
+  };
+
+  int Counted::Live = 0;
+
+  struct Unbuildable {
+    static int Attempts;
+
+    Unbuildable() {
+      ++Attempts;
+      throw std::runtime_error("no dataset");
+    }
+  };
+
+  int Unbuildable::Attempts = 0;
+}
+
+SCOPE_SUITE(sharedDataset)
+
+SCOPE_SUITE_FIXTURE(suiteFixtureBuiltOnce, Dataset) {
+  SCOPE_ASSERT_EQUAL(1, Dataset::Builds);
+  SCOPE_ASSERT_EQUAL(1000u, fixture.Rows.size());
+}
+
+SCOPE_SUITE_FIXTURE(suiteFixtureSharedWithSecond, Dataset) {
+  SCOPE_ASSERT_EQUAL(1, Dataset::Builds);
+  SCOPE_ASSERT_EQUAL(7, fixture.Rows.back());
+}
+
+SCOPE_SUITE(sharedFixtureUnits)
+
+SCOPE_TEST(sharedFixtureTearsDownAfterLastUser) {
+  scope::SharedFixture<Counted> shared(&scope::DefaultFixtureConstruct<Counted>);
+  shared.retain();
+  shared.retain();
+  shared.prepare();
+  SCOPE_ASSERT_EQUAL(1, Counted::Live);
+  shared.get();
+  SCOPE_ASSERT_EQUAL(1, Counted::Live);
+  SCOPE_ASSERT(shared.release().empty());
+  SCOPE_ASSERT_EQUAL(1, Counted::Live);
+  SCOPE_ASSERT(shared.release().empty());
+  SCOPE_ASSERT_EQUAL(0, Counted::Live);
+}
+
+SCOPE_TEST(sharedFixtureSetupFailsOnce) {
+  scope::SharedFixture<Unbuildable> shared(&scope::DefaultFixtureConstruct<Unbuildable>);
+  shared.prepare();
+  SCOPE_EXPECT(shared.get(), std::runtime_error);
+  SCOPE_EXPECT(shared.get(), std::runtime_error);
+  SCOPE_ASSERT_EQUAL(1, Unbuildable::Attempts);
+}
@@ -0,0 +1,81 @@
+/*
+	© 2016, Jon Stewart
+	Released under the terms of the Boost license (http://www.boost.org/LICENSE_1_0.txt). See License.txt for details.
+*/
+
+#include "scope/test.h"
+
+#include <stdexcept>
+#include <vector>
+
+#include <unistd.h>
+
+namespace {
+  struct Index {
+    static int Builds;
+
+    std::vector<int> Entries;
+    pid_t            BuiltIn;
+
+    Index(): Entries(4096, 3), BuiltIn(getpid()) {
+      ++Builds;
+    }
+  };
+
+  int Index::Builds = 0;
+
+  struct Page {
+    char Bytes[4096];
+  };
+
+  struct Offline {
+    Offline() {
+      throw std::runtime_error("index offline");
+    }
+  };
+}
+
+SCOPE_SUITE(snapshotIndex)
+
+SCOPE_SNAPSHOT_FIXTURE(snapshotRunsInItsOwnProcess, Index) {
+  SCOPE_ASSERT_EQUAL(1, Index::Builds);
+  SCOPE_ASSERT(getpid() != fixture.BuiltIn);
+}
+
+SCOPE_SNAPSHOT_FIXTURE(snapshotChangesStayInTheChild, Index) {
+  SCOPE_ASSERT_EQUAL(4096u, fixture.Entries.size());
+  SCOPE_ASSERT_EQUAL(3, fixture.Entries.front());
+  fixture.Entries.assign(10, -1);
+  ++Index::Builds;
+}
+
+SCOPE_SNAPSHOT_FIXTURE(snapshotSeesPristineFixture, Index) {
+  SCOPE_ASSERT_EQUAL(1, Index::Builds);
+  SCOPE_ASSERT_EQUAL(4096u, fixture.Entries.size());
+  SCOPE_ASSERT_EQUAL(3, fixture.Entries.back());
+  fixture.Entries.clear();
+}
+
+// the child is watched by the runner; it must not arm the runner's watchdog itself
+SCOPE_SNAPSHOT_FIXTURE_TIMEOUT(snapshotWithTimeout, Index, 60) {
+  SCOPE_ASSERT_EQUAL(1, Index::Builds);
+  SCOPE_ASSERT(getpid() != fixture.BuiltIn);
+}
+
+SCOPE_SUITE_FIXTURE(snapshotSharesWithSuiteFixture, Index) {
+  SCOPE_ASSERT_EQUAL(1, Index::Builds);
+  SCOPE_ASSERT_EQUAL(4096u, fixture.Entries.size());
+}
+
+SCOPE_SUITE(snapshotUnits)
+
+SCOPE_TEST(snapshotFixtureResolvedByPrepare) {
+  scope::SharedFixture<Page> shared(&scope::DefaultFixtureConstruct<Page>);
+  shared.prepare();
+  Page& first(shared.getMutable());
+  SCOPE_ASSERT_EQUAL(&first, &shared.getMutable());
+
+  scope::SharedFixture<Offline> offline(&scope::DefaultFixtureConstruct<Offline>);
+  offline.prepare();
+  SCOPE_EXPECT(offline.getMutable(), std::runtime_error);
+}
@@ -0,0 +1,103 @@
+/*
+	© 2016, Jon Stewart
+	Released under the terms of the Boost license (http://www.boost.org/LICENSE_1_0.txt). See License.txt for details.
+*/
+
+#include "scope/test.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace {
+  struct Plain {
+    int Values[16];
+  };
+
+  struct alignas(64) Wide {
+    char Byte;
+  };
+
+  struct Custom {
+    bool FromSpecialization;
+  };
+
+  const Plain* LastPlain = nullptr;
+  const Custom* LastCustom = nullptr;
+
+  void recordPlain(Plain& fixture) {
+    LastPlain = &fixture;
+  }
+
+  void recordCustom(Custom& fixture) {
+    SCOPE_ASSERT(fixture.FromSpecialization);
+    LastCustom = &fixture;
+  }
+}
+
+namespace scope {
+  template<> struct ArenaFixture<Plain>: std::true_type {};
+
+  template<> Custom* DefaultFixtureConstruct<Custom>() {
+    return new Custom{true};
+  }
+}
+
+SCOPE_TEST(arenaRewindsToMark) {
+  scope::Arena arena;
+  void* first = arena.allocate(100, 8);
+  {
+    scope::ArenaScope scope(arena);
+    SCOPE_ASSERT(arena.allocate(1000, 8) != first);
+  }
+  void* again = arena.allocate(1000, 8);
+  SCOPE_ASSERT(arena.owns(again));
+  SCOPE_ASSERT_EQUAL(static_cast<char*>(first) + 104, static_cast<char*>(again));
+}
+
+SCOPE_TEST(arenaAlignsAndGrows) {
+  scope::Arena arena;
+  arena.allocate(1, 1);
+  SCOPE_ASSERT_EQUAL(0u, reinterpret_cast<uintptr_t>(arena.create<Wide>()) % 64);
+
+  const scope::Arena::Mark start(arena.mark());
+  char* big = static_cast<char*>(arena.allocate(scope::Arena::FirstChunk * 3, 16));
+  big[scope::Arena::FirstChunk * 3 - 1] = 'x';
+  SCOPE_ASSERT(arena.owns(big + scope::Arena::FirstChunk * 3 - 1));
+
+  // the bigger chunk is kept, and reused without another malloc()
+  arena.rewind(start);
+  SCOPE_ASSERT_EQUAL(big, static_cast<char*>(arena.allocate(scope::Arena::FirstChunk * 3, 16)));
+}
+
+SCOPE_TEST(arenaAllocatorBacksContainers) {
+  scope::ArenaScope scope(scope::threadArena());
+  std::vector<int, scope::ArenaAllocator<int>> v(scope::testAllocator<int>());
+  SCOPE_ASSERT_NO_ALLOC(for (int i = 0; i < 1000; ++i) { v.push_back(i); });
+  SCOPE_ASSERT_EQUAL(999, v.back());
+  SCOPE_ASSERT(scope::threadArena().owns(v.data()));
+}
+
+SCOPE_TEST(optedInFixtureGoesInArena) {
+  scope::FixtureTest<Plain> test("recordPlain", __FILE__, recordPlain, &scope::DefaultFixtureConstruct<Plain>);
+  scope::TestResult result;
+  SCOPE_ASSERT_NO_ALLOC(test.Run(result));
+  SCOPE_ASSERT(result.passed());
+  SCOPE_ASSERT(scope::threadArena().owns(LastPlain));
+}
+
+#ifdef SCOPE_HAVE_PMR
+SCOPE_TEST(arenaMemoryResource) {
+  scope::ArenaScope scope(scope::threadArena());
+  std::pmr::vector<int> v(scope::testMemoryResource());
+  v.assign(100, 7);
+  SCOPE_ASSERT(scope::threadArena().owns(v.data()));
+}
+#endif
+
+SCOPE_TEST(specializedConstructionIsKept) {
+  scope::FixtureTest<Custom> test("recordCustom", __FILE__, recordCustom, &scope::DefaultFixtureConstruct<Custom>);
+  scope::TestResult result;
+  test.Run(result);
+  SCOPE_ASSERT(result.passed());
+  SCOPE_ASSERT(!scope::threadArena().owns(LastCustom));
+}
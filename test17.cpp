@@ -0,0 +1,84 @@
+/*
+	© 2016, Jon Stewart
+	Released under the terms of the Boost license (http://www.boost.org/LICENSE_1_0.txt). See License.txt for details.
+*/
+
+#include "scope/test.h"
+
+#include <stdexcept>
+#include <vector>
+
+namespace {
+  struct Buffer {
+    std::vector<char> Bytes;
+    std::size_t       Used;
+
+    Buffer(): Bytes(1 << 16), Used(0) {}
+
+    void reset() {
+      Used = 0;
+    }
+  };
+
+  struct Connection {
+    static int Builds,
+               Resets;
+    static bool FailReset;
+
+    Connection() {
+      ++Builds;
+    }
+
+    void reset() {
+      ++Resets;
+      if (FailReset) {
+        throw std::runtime_error("connection lost");
+      }
+    }
+  };
+
+  int Connection::Builds = 0;
+  int Connection::Resets = 0;
+  bool Connection::FailReset = false;
+
+  const Connection* LastConnection = nullptr;
+
+  void useConnection(Connection& c) {
+    LastConnection = &c;
+  }
+}
+
+SCOPE_FIXTURE_POOLED(pooledBufferStartsReset, Buffer) {
+  SCOPE_ASSERT_EQUAL(0u, fixture.Used);
+  SCOPE_ASSERT_EQUAL(std::size_t(1 << 16), fixture.Bytes.size());
+  fixture.Used = 100;
+}
+
+SCOPE_FIXTURE_POOLED(pooledBufferStartsResetAgain, Buffer) {
+  SCOPE_ASSERT_EQUAL(0u, fixture.Used);
+  fixture.Used = 200;
+}
+
+SCOPE_TEST(pooledFixtureIsReusedOnThread) {
+  scope::PooledFixtureTest<Connection> first("first", __FILE__, useConnection, &scope::DefaultFixtureConstruct<Connection>),
+                                       second("second", __FILE__, useConnection, &scope::DefaultFixtureConstruct<Connection>);
+  scope::TestResult result;
+  first.Run(result);
+  const Connection* built = LastConnection;
+  second.Run(result);
+  SCOPE_ASSERT(result.passed());
+  SCOPE_ASSERT_EQUAL(1, Connection::Builds);
+  SCOPE_ASSERT_EQUAL(1, Connection::Resets);
+  SCOPE_ASSERT_EQUAL(built, LastConnection);
+
+  // a failed reset fails the test, and the next one gets a new fixture
+  Connection::FailReset = true;
+  LastConnection = nullptr;
+  first.Run(result);
+  Connection::FailReset = false;
+  SCOPE_ASSERT_EQUAL(1u, result.Failures.size());
+  SCOPE_ASSERT_EQUAL("connection lost", result.Failures.front().Message);
+  SCOPE_ASSERT(!LastConnection);
+  second.Run(result);
+  SCOPE_ASSERT_EQUAL(2, Connection::Builds);
+}
@@ -0,0 +1,68 @@
+/*
+	© 2016, Jon Stewart
+	Released under the terms of the Boost license (http://www.boost.org/LICENSE_1_0.txt). See License.txt for details.
+*/
+
+#include "scope/test.h"
+
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+  std::vector<std::string> words() {
+    return {"alpha", "beta", "gamma"};
+  }
+
+  std::vector<int> noRows() {
+    throw std::runtime_error("no rows");
+  }
+
+  int Sum = 0;
+
+  void addRow(const int& row) {
+    Sum += row;
+  }
+}
+
+SCOPE_TEST_PARAM(paramWordIsLowercase, words()) {
+  for (char c: param) {
+    SCOPE_ASSERT(c >= 'a' && c <= 'z');
+  }
+}
+
+SCOPE_TEST_PARAM(paramSquares, std::vector<int>{1, 2, 3, 4}) {
+  SCOPE_ASSERT(param * param >= param);
+}
+
+SCOPE_TEST(paramTestExpandsIntoNamedCases) {
+  scope::ParamTest<std::vector<int>> test("rows", __FILE__, []() { return std::vector<int>{3, 4}; }, addRow, 2.0, 7);
+  std::vector<std::unique_ptr<scope::AutoRegister>> cases;
+  SCOPE_ASSERT(test.expand(cases));
+  SCOPE_ASSERT_EQUAL(2u, cases.size());
+  SCOPE_ASSERT_EQUAL("rows[0]", cases[0]->Name);
+  SCOPE_ASSERT_EQUAL("rows[1]", cases[1]->Name);
+  SCOPE_ASSERT_EQUAL(7, cases[1]->Line);
+  SCOPE_ASSERT_EQUAL(2.0, cases[1]->Timeout);
+
+  Sum = 0;
+  scope::TestResult result;
+  cases[1]->Run(result);
+  SCOPE_ASSERT_EQUAL(4, Sum);
+  test.Run(result);
+  SCOPE_ASSERT_EQUAL(11, Sum);
+  SCOPE_ASSERT(result.passed());
+}
+
+SCOPE_TEST(paramTestStaysWholeIfGeneratorThrows) {
+  scope::ParamTest<std::vector<int>> test("rows", __FILE__, noRows, addRow);
+  std::vector<std::unique_ptr<scope::AutoRegister>> cases;
+  SCOPE_ASSERT(!test.expand(cases));
+  SCOPE_ASSERT(cases.empty());
+
+  scope::TestResult result;
+  test.Run(result);
+  SCOPE_ASSERT_EQUAL(1u, result.Failures.size());
+  SCOPE_ASSERT_EQUAL("no rows", result.Failures.front().Message);
+}
@@ -65,6 +65,8 @@ namespace {
   // From a counting perspective, I think that Scope would
   // have to count every item in the sequence as an individual
   // test, but not count the initial closing lambda.
+  //
+  // SCOPE_TEST_PARAM(name, sequence) now does this; see test18.cpp.
   // scope::Test sequenceTests([]{
   //   return make_pair({1, 2, 3, 4, 5},
   //                   [](int x){ return x == 2; });
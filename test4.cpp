@@ -0,0 +1,159 @@
+/*
+	© 2016, Jon Stewart
+	Released under the terms of the Boost license (http://www.boost.org/LICENSE_1_0.txt). See License.txt for details.
+*/
+
+#include "scope/benchmark.h"
+#include "scope/baseline.h"
+
+#include <algorithm>
+#include <iterator>
+#include <sstream>
+#include <vector>
+
+SCOPE_BENCHMARK(vectorPushBack) {
+  std::vector<int> v;
+  while (state.keepRunning()) {
+    v.push_back(1);
+  }
+  scope::doNotOptimize(v);
+}
+
+SCOPE_BENCHMARK(emptyLoop) {
+  while (state.keepRunning()) {
+    ;
+  }
+}
+
+namespace {
+  void countCalls(scope::BenchmarkState& state) {
+    while (state.keepRunning()) {
+      ;
+    }
+  }
+
+  void failingBenchmark(scope::BenchmarkState& state) {
+    while (state.keepRunning()) {
+      SCOPE_ASSERT(false);
+    }
+  }
+}
+
+SCOPE_TEST(benchmarkCalibration) {
+  scope::BenchmarkOptions opts;
+  opts.MinSampleTime = std::chrono::microseconds(100);
+  opts.Samples = 3;
+
+  scope::BenchmarkCase bench("countCalls", __FILE__, countCalls);
+  scope::BenchmarkResult result;
+  scope::TestResult sink;
+  SCOPE_ASSERT(bench.measure(opts, result, sink));
+  SCOPE_ASSERT(sink.passed());
+  SCOPE_ASSERT_EQUAL(3u, result.Samples);
+  SCOPE_ASSERT(result.Iterations > 1);
+  SCOPE_ASSERT_EQUAL(std::string("countCalls"), result.Name);
+}
+
+SCOPE_TEST(benchmarkStateCountsIterations) {
+  scope::BenchmarkState state(5);
+  unsigned int n = 0;
+  while (state.keepRunning()) {
+    ++n;
+  }
+  SCOPE_ASSERT_EQUAL(5u, n);
+  SCOPE_ASSERT_EQUAL(5u, state.iterations());
+}
+
+SCOPE_TEST(failingBenchmarkReportsFailure) {
+  scope::BenchmarkCase bench("failingBenchmark", __FILE__, failingBenchmark);
+  scope::BenchmarkResult result;
+  scope::TestResult sink;
+  SCOPE_ASSERT(!bench.measure(scope::BenchmarkOptions(), result, sink));
+  SCOPE_ASSERT_EQUAL(1u, sink.Failures.size());
+}
+
+SCOPE_TEST(sampleStatsSummary) {
+  scope::StatsOptions opts;
+  opts.Resamples = 200;
+  std::vector<double> buf(scope::bufferSize(10, opts));
+  const double samples[] = {5, 3, 1, 4, 2, 9, 7, 6, 8, 10};
+  std::copy(std::begin(samples), std::end(samples), buf.begin());
+
+  const scope::SampleStats st(scope::analyzeSamples(buf.data(), 10, opts));
+  SCOPE_ASSERT_EQUAL(10u, st.N);
+  SCOPE_ASSERT_EQUAL(5.5, st.Mean);
+  SCOPE_ASSERT_EQUAL(5.5, st.Median);
+  SCOPE_ASSERT_EQUAL(2.5, st.Mad);
+  SCOPE_ASSERT_EQUAL(1.0, st.Min);
+  SCOPE_ASSERT_EQUAL(10.0, st.Max);
+  SCOPE_ASSERT(st.CiLow <= st.Mean && st.Mean <= st.CiHigh);
+  SCOPE_ASSERT(st.CiLow >= st.Min && st.CiHigh <= st.Max);
+  SCOPE_ASSERT_EQUAL(0u, st.outliers());
+  SCOPE_ASSERT_EQUAL(1.0, buf[0]); // sorted in place
+}
+
+SCOPE_TEST(sampleStatsTukeyFences) {
+  scope::StatsOptions opts;
+  opts.Resamples = 0;
+  std::vector<double> buf(scope::bufferSize(10, opts));
+  // quartiles are 10 and 11, so the fences are at 8.5/12.5 and 7/14
+  const double samples[] = {10, 10, 10, 10, 11, 11, 11, 11, 13, 100};
+  std::copy(std::begin(samples), std::end(samples), buf.begin());
+
+  const scope::SampleStats st(scope::analyzeSamples(buf.data(), 10, opts));
+  SCOPE_ASSERT_EQUAL(1u, st.HighMild);
+  SCOPE_ASSERT_EQUAL(1u, st.HighSevere);
+  SCOPE_ASSERT_EQUAL(0u, st.LowMild + st.LowSevere);
+}
+
+namespace {
+  scope::BenchmarkResult fakeResult(const char* name, double base, double step) {
+    scope::BenchmarkResult r;
+    r.Name = name;
+    r.SourceFile = __FILE__;
+    r.Iterations = 100;
+    for (unsigned int i = 0; i < 20; ++i) {
+      r.SampleNs.push_back(base + step * (i % 5));
+    }
+    r.Samples = 20;
+    return r;
+  }
+}
+
+SCOPE_TEST(baselineRoundTrip) {
+  std::vector<scope::BenchmarkResult> saved = {fakeResult("a\"b", 10.125, 0.5), fakeResult("c", 3, 0)};
+  std::stringstream buf;
+  scope::writeBaseline(buf, saved);
+
+  std::vector<scope::BenchmarkResult> loaded;
+  std::string error;
+  SCOPE_ASSERT(scope::readBaseline(buf, loaded, error));
+  SCOPE_ASSERT_EQUAL(2u, loaded.size());
+  SCOPE_ASSERT_EQUAL(std::string("a\"b"), loaded[0].Name);
+  SCOPE_ASSERT_EQUAL(100u, loaded[0].Iterations);
+  SCOPE_ASSERT_EQUAL(saved[0].SampleNs, loaded[0].SampleNs);
+}
+
+SCOPE_TEST(baselineRejectsGarbage) {
+  std::stringstream buf("{\"benchmarks\": [{\"name\": 5");
+  std::vector<scope::BenchmarkResult> loaded;
+  std::string error;
+  SCOPE_ASSERT(!scope::readBaseline(buf, loaded, error));
+  SCOPE_ASSERT(!error.empty());
+}
+
+SCOPE_TEST(baselineFlagsSignificantRegressions) {
+  std::vector<scope::BenchmarkResult> base = {fakeResult("same", 10, 1), fakeResult("slower", 10, 1), fakeResult("slightly", 10, 0.01)},
+                                      cur  = {fakeResult("same", 10, 1), fakeResult("slower", 12, 1), fakeResult("new", 1, 0),
+                                              fakeResult("slightly", 10.2, 0.01)};
+
+  const std::vector<scope::BaselineComparison> comps(scope::compareBaseline(base, cur, 0.05, 0.05));
+  SCOPE_ASSERT_EQUAL(4u, comps.size());
+  SCOPE_ASSERT(!comps[0].Regressed);
+  SCOPE_ASSERT(comps[1].Regressed);
+  SCOPE_ASSERT(comps[1].PValue < 0.001);
+  SCOPE_ASSERT(comps[2].Missing);
+  // consistently slower, but by less than the allowed regression
+  SCOPE_ASSERT(comps[3].PValue < 0.05);
+  SCOPE_ASSERT(!comps[3].Regressed);
+}
@@ -0,0 +1,92 @@
+/*
+	© 2016, Jon Stewart
+	Released under the terms of the Boost license (http://www.boost.org/LICENSE_1_0.txt). See License.txt for details.
+*/
+
+#include "scope/test.h"
+#include "scope/benchmark.h"
+
+#include <memory>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+SCOPE_TEST(noAllocInSum) {
+  std::vector<int> v(10, 1);
+  int sum = 0;
+  SCOPE_ASSERT_NO_ALLOC(sum = std::accumulate(v.begin(), v.end(), 0));
+  SCOPE_ASSERT_EQUAL(10, sum);
+}
+
+SCOPE_TEST(maxAllocationsAllowsReserve) {
+  std::vector<int> v;
+  SCOPE_ASSERT_MAX_ALLOCATIONS(1, v.reserve(100));
+}
+
+SCOPE_TEST_FAILS(allocationLimitExceeded) {
+  std::vector<std::unique_ptr<int>> v;
+  SCOPE_ASSERT_MAX_ALLOCATIONS(2, for (int i = 0; i < 3; ++i) { v.emplace_back(new int(i)); });
+}
+
+void emptyTestBody() {}
+
+SCOPE_TEST(testRunsWithoutAllocating) {
+  scope::BoundTest test("emptyTestBody", __FILE__, emptyTestBody, false);
+  scope::TestResult result;
+  SCOPE_ASSERT_NO_ALLOC(test.Run(result));
+  SCOPE_ASSERT(result.passed());
+}
+
+// registration happens before main(), so it must not touch the heap
+SCOPE_TEST(registeringDoesNotAllocate) {
+  SCOPE_ASSERT_NO_ALLOC(scope::BoundTest test("aTestNameLongerThanAnySmallStringBuffer", "some/deeply/nested/source/dir/test.cpp",
+                                              emptyTestBody, false));
+}
+
+SCOPE_TEST(allocationScopeCountsBytes) {
+  scope::AllocationScope allocs;
+  std::unique_ptr<char[]> buf(new char[100]);
+  scope::doNotOptimize(buf.get()); // or the optimizer drops the pair
+  buf.reset();
+  const scope::AllocationCounts counts(allocs.counts());
+  SCOPE_ASSERT_EQUAL(1u, counts.Allocations);
+  SCOPE_ASSERT_EQUAL(1u, counts.Deallocations);
+  SCOPE_ASSERT_EQUAL(100u, counts.BytesAllocated);
+  SCOPE_ASSERT_EQUAL(100u, counts.BytesFreed);
+}
+
+SCOPE_TEST(leakTrackerReportsLiveBlocks) {
+  scope::LeakScope leaks;
+  // the optimizer may drop blocks which never escape
+  int* kept = new int(5);
+  char* freed = new char[7];
+  std::unique_ptr<char[]> alsoKept(new char[24]);
+  scope::doNotOptimize(kept);
+  scope::doNotOptimize(freed);
+  scope::doNotOptimize(alsoKept.get());
+  delete[] freed;
+  const scope::LeakReport report(leaks.finish());
+  delete kept;
+
+  SCOPE_ASSERT_EQUAL(2u, report.Count);
+  SCOPE_ASSERT_EQUAL(sizeof(int) + 24, report.Bytes);
+  SCOPE_ASSERT_EQUAL({sizeof(int), std::size_t(24)}, report.Sizes);
+}
+
+SCOPE_TEST(leakTrackerCountsFreesOnOtherThreads) {
+  scope::LeakScope leaks;
+  int* handedOff = new int(3);
+  std::thread([handedOff]() { delete handedOff; }).join();
+  const scope::LeakReport report(leaks.finish());
+  SCOPE_ASSERT_EQUAL(0u, report.Count);
+  SCOPE_ASSERT_EQUAL(0u, report.Bytes);
+}
+
+SCOPE_TEST(leakTrackerIgnoresOlderBlocks) {
+  std::unique_ptr<int> older(new int(1));
+  scope::LeakScope leaks;
+  older.reset();
+  const scope::LeakReport report(leaks.finish());
+  SCOPE_ASSERT_EQUAL(0u, report.Count);
+  SCOPE_ASSERT_EQUAL(0u, report.Bytes);
+}
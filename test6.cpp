@@ -0,0 +1,38 @@
+/*
+	© 2016, Jon Stewart
+	Released under the terms of the Boost license (http://www.boost.org/LICENSE_1_0.txt). See License.txt for details.
+*/
+
+#include "scope/test.h"
+#include "scope/benchmark.h"
+#include "scope/resources.h"
+
+#include <cstdlib>
+#include <cstring>
+
+SCOPE_TEST(resourceUsageCountsFaults) {
+  // freshly mapped pages fault on first touch
+  const std::size_t size = 16 << 20;
+  const scope::ResourceUsage before(scope::threadResourceUsage());
+  char* buf = static_cast<char*>(std::malloc(size));
+  std::memset(buf, 1, size);
+  scope::doNotOptimize(buf); // keeps the memset, and so the faults
+  const scope::ResourceUsage used(scope::threadResourceUsage() - before);
+  std::free(buf);
+  SCOPE_ASSERT(used.MinorFaults > 0);
+  SCOPE_ASSERT(used.UserMs + used.SysMs >= 0.0);
+  SCOPE_ASSERT(used.MaxRssKb >= 0);
+}
+
+SCOPE_TEST(resourceUsageDifference) {
+  scope::ResourceUsage a = {5.0, 2.0, 10, 1, 4, 3, 2048},
+                       b = {1.5, 1.0, 4, 1, 1, 0, 1024};
+  const scope::ResourceUsage d(a - b);
+  SCOPE_ASSERT_EQUAL(3.5, d.UserMs);
+  SCOPE_ASSERT_EQUAL(1.0, d.SysMs);
+  SCOPE_ASSERT_EQUAL(6, d.MinorFaults);
+  SCOPE_ASSERT_EQUAL(0, d.MajorFaults);
+  SCOPE_ASSERT_EQUAL(3, d.VoluntarySwitches);
+  SCOPE_ASSERT_EQUAL(3, d.InvoluntarySwitches);
+  SCOPE_ASSERT_EQUAL(1024, d.MaxRssKb);
+}
@@ -0,0 +1,79 @@
+/*
+	© 2016, Jon Stewart
+	Released under the terms of the Boost license (http://www.boost.org/LICENSE_1_0.txt). See License.txt for details.
+*/
+
+#include "scope/test.h"
+#include "scope/history.h"
+#include "scope/shard.h"
+
+#include <limits>
+#include <sstream>
+#include <vector>
+
+SCOPE_TEST(historyRoundTrip) {
+  scope::DurationHistory history;
+  history.record("test1.cpp", "slow", 2.5);
+  history.record("test2.cpp", "fast", 0.001);
+
+  std::stringstream buf;
+  history.save(buf);
+  scope::DurationHistory loaded;
+  SCOPE_ASSERT(loaded.load(buf));
+  SCOPE_ASSERT_EQUAL(2.5, loaded.expected("test1.cpp", "slow"));
+  SCOPE_ASSERT_EQUAL(0.001, loaded.expected("test2.cpp", "fast"));
+}
+
+SCOPE_TEST(historySmoothsDurations) {
+  scope::DurationHistory history;
+  history.record("test1.cpp", "t", 4.0);
+  history.record("test1.cpp", "t", 2.0);
+  SCOPE_ASSERT_EQUAL(3.0, history.expected("test1.cpp", "t"));
+}
+
+SCOPE_TEST(historyKeysOnSourceAndName) {
+  scope::DurationHistory history;
+  history.record("test1.cpp", "t", 1.0);
+  SCOPE_ASSERT_EQUAL(std::numeric_limits<double>::infinity(), history.expected("test2.cpp", "t"));
+}
+
+SCOPE_TEST(historyRejectsGarbage) {
+  std::istringstream in("# comment\n0.5\ttest1.cpp\tok\nslow\ttest1.cpp\tbad\n");
+  scope::DurationHistory history;
+  SCOPE_ASSERT(!history.load(in));
+  SCOPE_ASSERT_EQUAL(0.5, history.expected("test1.cpp", "ok"));
+}
+
+SCOPE_TEST(shardHashIsStable) {
+  // FNV-1a of "a.cpp\0t", which must never change or shards would reshuffle
+  SCOPE_ASSERT_EQUAL(scope::shardHash("a.cpp", "t"), scope::shardHash(std::string("a.cpp"), std::string("t")));
+  SCOPE_ASSERT(scope::shardHash("a.cpp", "t") != scope::shardHash("a.cpp", "u"));
+  SCOPE_ASSERT(scope::shardHash("a.cp", "pt") != scope::shardHash("a.cpp", "t"));
+}
+
+SCOPE_TEST(planShardsBalancesCost) {
+  std::vector<scope::ShardItem> items = {
+    {"a.cpp", "t1", 5.0}, {"a.cpp", "t2", 4.0}, {"b.cpp", "t3", 3.0},
+    {"b.cpp", "t4", 3.0}, {"c.cpp", "t5", 2.0}, {"c.cpp", "t6", 1.0}
+  };
+  const std::vector<unsigned int> plan(scope::planShards(items, 2));
+  double load[2] = {0.0, 0.0};
+  for (std::size_t i = 0; i < items.size(); ++i) {
+    SCOPE_ASSERT(plan[i] < 2);
+    load[plan[i]] += items[i].Cost;
+  }
+  SCOPE_ASSERT_EQUAL(9.0, load[0]);
+  SCOPE_ASSERT_EQUAL(9.0, load[1]);
+}
+
+SCOPE_TEST(planShardsIgnoresRegistrationOrder) {
+  std::vector<scope::ShardItem> items = {
+    {"a.cpp", "t1", 1.0}, {"a.cpp", "t2", 1.0}, {"b.cpp", "t3", 1.0}
+  };
+  std::vector<scope::ShardItem> reversed(items.rbegin(), items.rend());
+  const std::vector<unsigned int> plan(scope::planShards(items, 2)),
+                                  revPlan(scope::planShards(reversed, 2));
+  for (std::size_t i = 0; i < items.size(); ++i) {
+    SCOPE_ASSERT_EQUAL(plan[i], revPlan[items.size() - 1 - i]);
+  }
+}
@@ -0,0 +1,67 @@
+/*
+	© 2016, Jon Stewart
+	Released under the terms of the Boost license (http://www.boost.org/LICENSE_1_0.txt). See License.txt for details.
+*/
+
+#include "scope/test.h"
+#include "scope/watchdog.h"
+
+#include <sstream>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+SCOPE_TEST(parseDurationUnits) {
+  double secs = 0.0;
+  SCOPE_ASSERT(scope::parseDuration("30", secs));
+  SCOPE_ASSERT_EQUAL(30.0, secs);
+  SCOPE_ASSERT(scope::parseDuration("1.5s", secs));
+  SCOPE_ASSERT_EQUAL(1.5, secs);
+  SCOPE_ASSERT(scope::parseDuration("250ms", secs));
+  SCOPE_ASSERT_EQUAL(0.25, secs);
+  SCOPE_ASSERT(scope::parseDuration("2m", secs));
+  SCOPE_ASSERT_EQUAL(120.0, secs);
+  SCOPE_ASSERT(!scope::parseDuration("fast", secs));
+  SCOPE_ASSERT(!scope::parseDuration("3h", secs));
+  SCOPE_ASSERT(!scope::parseDuration("-1s", secs));
+}
+
+SCOPE_TEST(watchdogKillsOverdueChild) {
+  const pid_t pid = ::fork();
+  if (pid == 0) {
+    ::sleep(10);
+    ::_exit(0);
+  }
+  SCOPE_ASSERT(pid > 0);
+  std::ostringstream reports;
+  scope::Watchdog watchdog(reports);
+  const unsigned int alarm = watchdog.arm("sleepy", 0.05, pid);
+  int status = 0;
+  SCOPE_ASSERT_EQUAL(pid, ::waitpid(pid, &status, 0));
+  SCOPE_ASSERT(watchdog.disarm(alarm));
+  SCOPE_ASSERT(WIFSIGNALED(status));
+  SCOPE_ASSERT_EQUAL(SIGKILL, WTERMSIG(status));
+  // written before the kill, under the lock disarm() took
+  const std::string report(reports.str());
+  SCOPE_ASSERT_EQUAL(0u, report.find("Timeout: sleepy has run for "));
+  SCOPE_ASSERT(report.find("over its limit of 0.05s; killing it\n") != std::string::npos);
+}
+
+SCOPE_TEST(overdueReportKeepsLimitPrecision) {
+  std::ostringstream report;
+  scope::reportOverdue("slow", 21.3, 20, "; aborting", report);
+  SCOPE_ASSERT_EQUAL(std::string("Timeout: slow has run for 21.3s, over its limit of 20s; aborting\n"), report.str());
+  report.str("");
+  scope::reportOverdue("slow", 3, 2.5, "", report);
+  SCOPE_ASSERT_EQUAL(std::string("Timeout: slow has run for 3.0s, over its limit of 2.5s\n"), report.str());
+}
+
+SCOPE_TEST(watchdogDisarmedInTime) {
+  scope::Watchdog watchdog;
+  const unsigned int alarm = watchdog.arm("quick", 60, 0);
+  SCOPE_ASSERT(!watchdog.disarm(alarm));
+}
+
+SCOPE_TEST_TIMEOUT(timeoutOverrideRegisters, 60) {
+  SCOPE_ASSERT(true);
+}
@@ -0,0 +1,61 @@
+/*
+	© 2016, Jon Stewart
+	Released under the terms of the Boost license (http://www.boost.org/LICENSE_1_0.txt). See License.txt for details.
+*/
+
+#include "scope/test.h"
+#include "scope/reporters.h"
+
+#include <sstream>
+
+namespace {
+  // the events the runner sends for one failed test with a metric
+  void reportOne(scope::ResultSink& sink) {
+    scope::TestCommon test("quoted\"name", "test9.cpp");
+    scope::Failure fail("Expected: 1, Actual: 2", "test9.cpp", 7);
+    fail.Expected = "1";
+    fail.Actual = "2";
+    sink.testStarted(test);
+    sink.testFailed(test, fail);
+    sink.testMetrics(test, scope::MetricList{scope::Metric("allocs", 3)});
+    sink.testFinished(test, 0.5, false);
+  }
+}
+
+SCOPE_TEST(jsonLinesReporterWritesOneLinePerTest) {
+  std::ostringstream out;
+  scope::JsonLinesReporter report(out);
+  reportOne(report);
+  SCOPE_ASSERT_EQUAL(
+    "{\"type\": \"test\", \"name\": \"quoted\\\"name\", \"source\": \"test9.cpp\", \"passed\": false, \"seconds\": 0.5, "
+    "\"failures\": [{\"file\": \"test9.cpp\", \"line\": 7, \"message\": \"Expected: 1, Actual: 2\", \"expected\": \"1\", \"actual\": \"2\"}], "
+    "\"metrics\": {\"allocs\": 3}}\n",
+    out.str()
+  );
+}
+
+SCOPE_TEST(junitReporterIsAlwaysClosed) {
+  std::stringstream out;
+  scope::JunitReporter report(out);
+  const std::string tail("</testsuite>\n</testsuites>\n");
+  SCOPE_ASSERT(out.str().size() > tail.size());
+  SCOPE_ASSERT_EQUAL(tail, out.str().substr(out.str().size() - tail.size()));
+
+  reportOne(report);
+  const std::string xml(out.str());
+  SCOPE_ASSERT_EQUAL(tail, xml.substr(xml.size() - tail.size()));
+  SCOPE_ASSERT(xml.find("name=\"quoted&quot;name\"") != std::string::npos);
+  SCOPE_ASSERT(xml.find("<property name=\"allocs\" value=\"3\"/>") != std::string::npos);
+  SCOPE_ASSERT_EQUAL(xml.find("<testcase"), xml.rfind("<testcase"));
+}
+
+SCOPE_TEST(tapReporterPlansAtEnd) {
+  std::ostringstream out;
+  scope::TapReporter report(out);
+  reportOne(report);
+  report.runError("regressed");
+  report.runFinished();
+  const std::string tap(out.str());
+  SCOPE_ASSERT_EQUAL(0u, tap.find("TAP version 13\nnot ok 1 - quoted\"name\n"));
+  SCOPE_ASSERT(tap.find("not ok 2 - regressed\n1..2\n") != std::string::npos);
+}